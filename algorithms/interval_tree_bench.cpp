@@ -8,6 +8,7 @@
 #include "absl/random/random.h"
 #include "interval_region.h"
 #include "interval_tree.h"
+#include "systems/instrumentation.h"
 
 static void BM_IntervalTree_Intersects(benchmark::State &state) {
   absl::BitGen gen;
@@ -21,10 +22,12 @@ static void BM_IntervalTree_Intersects(benchmark::State &state) {
               << expected_depth << " for n=" << state.range(0) << std::endl;
   }
 
+  BenchmarkCounters counters(state);
   for (auto _ : state) {
     float q = absl::Uniform(gen, 0, 1.0);
     benchmark::DoNotOptimize(tree.queryIntervalTree(q));
   }
+  counters.stop();
 }
 
 // Register the function as a benchmark
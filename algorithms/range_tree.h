@@ -0,0 +1,181 @@
+#ifndef ALGORITHMS_RANGE_TREE_H_
+#define ALGORITHMS_RANGE_TREE_H_
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include "systems/work_stealing_pool.h"
+
+using Point2 = Eigen::Vector2f;
+using Box2 = Eigen::AlignedBox2f;
+
+// Results of a batch of range queries in compressed sparse row form: the hits
+// for query q are ids[offsets[q]] ... ids[offsets[q + 1] - 1].
+struct CsrResult {
+  std::span<const uint32_t> operator[](size_t q) const {
+    return std::span(ids).subspan(offsets[q], offsets[q + 1] - offsets[q]);
+  }
+
+  size_t size() const { return offsets.size() - 1; }
+
+  std::vector<size_t> offsets = {0};
+  std::vector<uint32_t> ids;
+};
+
+// Static 2D range tree for orthogonal range queries, following chapter 5 of
+// "Computational Geometry" by de Berg et al. (3rd ed.)
+//
+// Rather than a pointer-based primary tree with an associated structure per
+// node, the tree is stored level by level (a "merge sort tree"): at level l the
+// points are in x order, grouped into aligned blocks of 2^l points, and each
+// block is sorted by y. The blocks at level l are exactly the canonical subsets
+// of the nodes at height l of a balanced primary tree. A query decomposes its x
+// range into O(log n) such blocks and binary searches each one on y, which
+// gives O(log^2 n + k) per query with every level a contiguous array.
+class RangeTree2D {
+ public:
+  explicit RangeTree2D(const std::vector<Point2>& points) {
+    const size_t n = points.size();
+    std::vector<uint32_t> by_x(n);
+    std::iota(by_x.begin(), by_x.end(), 0);
+    std::sort(by_x.begin(), by_x.end(), [&](uint32_t a, uint32_t b) {
+      return points[a].x() < points[b].x();
+    });
+
+    xs.reserve(n);
+    for (uint32_t id : by_x) xs.push_back(points[id].x());
+
+    // Level 0 has blocks of a single point, so x order is also y order.
+    auto& leaves = levels.emplace_back();
+    leaves.ids = by_x;
+    for (uint32_t id : by_x) leaves.ys.push_back(points[id].y());
+
+    // Each level merges pairs of adjacent blocks from the level below.
+    for (size_t block = 1; block < n; block *= 2) {
+      const Level& below = levels.back();
+      Level above;
+      above.ys.resize(n);
+      above.ids.resize(n);
+      for (size_t begin = 0; begin < n; begin += 2 * block) {
+        const size_t mid = std::min(begin + block, n);
+        const size_t end = std::min(begin + 2 * block, n);
+        size_t i = begin, j = mid, out = begin;
+        while (i < mid && j < end) {
+          const size_t from = below.ys[j] < below.ys[i] ? j++ : i++;
+          above.ys[out] = below.ys[from];
+          above.ids[out++] = below.ids[from];
+        }
+        for (; i < mid; ++i, ++out) {
+          above.ys[out] = below.ys[i];
+          above.ids[out] = below.ids[i];
+        }
+        for (; j < end; ++j, ++out) {
+          above.ys[out] = below.ys[j];
+          above.ids[out] = below.ids[j];
+        }
+      }
+      levels.push_back(std::move(above));
+    }
+  }
+
+  size_t size() const { return xs.size(); }
+
+  // Appends the indices (into the constructor's input) of all points inside
+  // the closed box to `hits`, in no particular order.
+  void query(const Box2& box, std::vector<uint32_t>& hits) const {
+    size_t lo = std::lower_bound(xs.begin(), xs.end(), box.min().x()) -
+                xs.begin();
+    size_t hi = std::upper_bound(xs.begin(), xs.end(), box.max().x()) -
+                xs.begin();
+
+    // Bottom-up decomposition of [lo, hi) into aligned blocks: at each level,
+    // an odd block index on either end is a canonical subset that its parent
+    // only partially covers.
+    for (size_t l = 0; lo < hi; ++l) {
+      const size_t block = size_t{1} << l;
+      if ((lo >> l) & 1) {
+        reportBlock(levels[l], lo, lo + block, box, hits);
+        lo += block;
+      }
+      if (lo < hi && ((hi >> l) & 1)) {
+        hi -= block;
+        reportBlock(levels[l], hi, hi + block, box, hits);
+      }
+    }
+  }
+
+  std::vector<uint32_t> query(const Box2& box) const {
+    std::vector<uint32_t> hits;
+    query(box, hits);
+    return hits;
+  }
+
+  // Answers a batch of queries in parallel. Queries are scheduled one at a
+  // time on the work-stealing pool, since a few large boxes can dominate the
+  // cost of a batch. Each worker appends hits to its own buffer, and the
+  // buffers are then stitched together into a single CSR result.
+  CsrResult batchQuery(std::span<const Box2> boxes,
+                       WorkStealingPool& pool) const {
+    struct Slice {
+      uint32_t worker;
+      size_t begin;
+      size_t count;
+    };
+    std::vector<Slice> slices(boxes.size());
+    std::vector<std::vector<uint32_t>> buffers(pool.size());
+
+    pool.parallelFor(boxes.size(), [&](size_t q, size_t worker) {
+      auto& buffer = buffers[worker];
+      const size_t begin = buffer.size();
+      query(boxes[q], buffer);
+      slices[q] = {static_cast<uint32_t>(worker), begin, buffer.size() - begin};
+    });
+
+    CsrResult result;
+    result.offsets.resize(boxes.size() + 1);
+    for (size_t q = 0; q < boxes.size(); ++q) {
+      result.offsets[q + 1] = result.offsets[q] + slices[q].count;
+    }
+    result.ids.resize(result.offsets.back());
+
+    pool.parallelFor(boxes.size(), [&](size_t q, size_t) {
+      const auto& slice = slices[q];
+      const auto src = buffers[slice.worker].begin() + slice.begin;
+      std::copy(src, src + slice.count, result.ids.begin() + result.offsets[q]);
+    });
+    return result;
+  }
+
+  // Points at one level of the tree, in x order by block and y order within
+  // each block.
+  struct Level {
+    std::vector<float> ys;
+    std::vector<uint32_t> ids;
+  };
+
+  std::vector<float> xs;  // All x coordinates, sorted.
+  std::vector<Level> levels;
+
+ private:
+  static void reportBlock(const Level& level,
+                          size_t begin,
+                          size_t end,
+                          const Box2& box,
+                          std::vector<uint32_t>& hits) {
+    const auto first = level.ys.begin();
+    const auto y_lo =
+        std::lower_bound(first + begin, first + end, box.min().y());
+    const auto y_hi = std::upper_bound(y_lo, first + end, box.max().y());
+    hits.insert(hits.end(),
+                level.ids.begin() + (y_lo - first),
+                level.ids.begin() + (y_hi - first));
+  }
+};
+
+#endif  // ALGORITHMS_RANGE_TREE_H_
@@ -0,0 +1,90 @@
+// Run in opt mode for accurate timings, with:
+// bazel run --compilation_mode=opt algorithms:range_tree_bench
+
+#include <benchmark/benchmark.h>
+
+#include <thread>
+#include <vector>
+
+#include "absl/random/random.h"
+#include "range_tree.h"
+#include "systems/instrumentation.h"
+#include "systems/work_stealing_pool.h"
+
+constexpr int kNumPoints = 1 << 20;
+constexpr int kBatchSize = 1 << 14;
+
+std::vector<Point2> randomPoints(int n) {
+  absl::BitGen gen;
+  std::vector<Point2> points;
+  points.reserve(n);
+  for (int i = 0; i < n; ++i) {
+    points.emplace_back(absl::Uniform(gen, 0.f, 1.f),
+                        absl::Uniform(gen, 0.f, 1.f));
+  }
+  return points;
+}
+
+// Mostly small boxes with a few very large ones, so that the per-query cost is
+// heavily skewed, as in our production traffic.
+std::vector<Box2> skewedBoxes(int n) {
+  absl::BitGen gen;
+  std::vector<Box2> boxes;
+  boxes.reserve(n);
+  for (int i = 0; i < n; ++i) {
+    const float width = absl::Bernoulli(gen, 0.01)
+                            ? absl::Uniform(gen, 0.05f, 0.2f)  // large
+                            : absl::Uniform(gen, 0.f, 0.01f);  // small
+    Point2 lo(absl::Uniform(gen, 0.f, 1.f - width),
+              absl::Uniform(gen, 0.f, 1.f - width));
+    boxes.emplace_back(lo, lo + Point2(width, width));
+  }
+  return boxes;
+}
+
+static void BM_RangeTree_Query(benchmark::State& state) {
+  const RangeTree2D tree(randomPoints(kNumPoints));
+  const auto boxes = skewedBoxes(kBatchSize);
+  std::vector<uint32_t> hits;
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    hits.clear();
+    for (const auto& box : boxes) tree.query(box, hits);
+    benchmark::DoNotOptimize(hits.data());
+  }
+  counters.stop();
+  state.counters["queries/s"] = benchmark::Counter(
+      state.iterations() * boxes.size(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_RangeTree_Query)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Scaling of the batched API from 1 to N threads.
+static void BM_RangeTree_BatchQuery(benchmark::State& state) {
+  const RangeTree2D tree(randomPoints(kNumPoints));
+  const auto boxes = skewedBoxes(kBatchSize);
+  size_t num_hits = 0;
+  // Workers started after the counters are counted as they exit.
+  BenchmarkCounters counters(state);
+  counters.pause();
+  {
+    WorkStealingPool pool(state.range(0));
+    counters.resume();
+    for (auto _ : state) {
+      const auto result = tree.batchQuery(boxes, pool);
+      num_hits = result.ids.size();
+      benchmark::DoNotOptimize(result.ids.data());
+    }
+    counters.pause();
+  }
+  counters.stop();
+  state.counters["queries/s"] = benchmark::Counter(
+      state.iterations() * boxes.size(), benchmark::Counter::kIsRate);
+  state.counters["hits/query"] =
+      static_cast<double>(num_hits) / boxes.size();
+}
+BENCHMARK(BM_RangeTree_BatchQuery)
+    ->DenseRange(1, std::max(1u, std::thread::hardware_concurrency()))
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
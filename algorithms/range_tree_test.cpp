@@ -0,0 +1,107 @@
+#include "range_tree.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+#include "gmock/gmock.h"
+
+using ::testing::IsEmpty;
+using ::testing::UnorderedElementsAre;
+
+namespace {
+
+std::vector<uint32_t> bruteForce(const std::vector<Point2>& points,
+                                 const Box2& box) {
+  std::vector<uint32_t> hits;
+  for (uint32_t i = 0; i < points.size(); ++i) {
+    if (box.contains(points[i])) hits.push_back(i);
+  }
+  return hits;
+}
+
+// Hits are reported in no particular order.
+std::vector<uint32_t> sorted(std::span<const uint32_t> hits) {
+  std::vector<uint32_t> result(hits.begin(), hits.end());
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+std::vector<Point2> randomPoints(size_t n, std::mt19937& gen) {
+  std::uniform_real_distribution<float> coord(0, 1);
+  std::vector<Point2> points;
+  for (size_t i = 0; i < n; ++i) points.emplace_back(coord(gen), coord(gen));
+  return points;
+}
+
+std::vector<Box2> randomBoxes(size_t n, std::mt19937& gen) {
+  std::uniform_real_distribution<float> coord(-0.1, 1.1);
+  std::vector<Box2> boxes;
+  for (size_t i = 0; i < n; ++i) {
+    Point2 a(coord(gen), coord(gen));
+    Point2 b(coord(gen), coord(gen));
+    boxes.emplace_back(a.cwiseMin(b), a.cwiseMax(b));
+  }
+  return boxes;
+}
+
+}  // namespace
+
+TEST(RangeTreeTest, EmptyTree) {
+  RangeTree2D tree({});
+  EXPECT_THAT(tree.query(Box2(Point2(-1, -1), Point2(1, 1))), IsEmpty());
+}
+
+TEST(RangeTreeTest, ClosedBoundaries) {
+  RangeTree2D tree({{0, 0}, {1, 1}, {1, 2}, {2, 1}, {3, 3}});
+  EXPECT_THAT(tree.query(Box2(Point2(1, 1), Point2(2, 2))),
+              UnorderedElementsAre(1, 2, 3));
+  EXPECT_THAT(tree.query(Box2(Point2(1, 1), Point2(1, 1))),
+              UnorderedElementsAre(1));
+  EXPECT_THAT(tree.query(Box2(Point2(4, 4), Point2(5, 5))), IsEmpty());
+}
+
+TEST(RangeTreeTest, DuplicatePoints) {
+  RangeTree2D tree({{1, 1}, {1, 1}, {1, 1}});
+  EXPECT_THAT(tree.query(Box2(Point2(0, 0), Point2(1, 1))),
+              UnorderedElementsAre(0, 1, 2));
+}
+
+TEST(RangeTreeTest, MatchesBruteForce) {
+  std::mt19937 gen(42);
+  // Include sizes that are not powers of two, so that the last block at each
+  // level is partial.
+  for (size_t n : {1, 2, 3, 17, 100, 1000}) {
+    const auto points = randomPoints(n, gen);
+    RangeTree2D tree(points);
+    for (const auto& box : randomBoxes(200, gen)) {
+      EXPECT_EQ(bruteForce(points, box), sorted(tree.query(box)));
+    }
+  }
+}
+
+TEST(RangeTreeTest, BatchQueryMatchesSingleQueries) {
+  std::mt19937 gen(7);
+  const auto points = randomPoints(5000, gen);
+  const auto boxes = randomBoxes(500, gen);
+  RangeTree2D tree(points);
+
+  for (size_t num_threads : {1, 2, 4}) {
+    WorkStealingPool pool(num_threads);
+    const CsrResult result = tree.batchQuery(boxes, pool);
+    ASSERT_EQ(boxes.size(), result.size());
+    EXPECT_EQ(result.ids.size(), result.offsets.back());
+    for (size_t q = 0; q < boxes.size(); ++q) {
+      EXPECT_EQ(sorted(tree.query(boxes[q])), sorted(result[q]));
+    }
+  }
+}
+
+TEST(RangeTreeTest, BatchQueryEmptyBatch) {
+  RangeTree2D tree({{0, 0}});
+  WorkStealingPool pool(2);
+  const CsrResult result = tree.batchQuery({}, pool);
+  EXPECT_EQ(0, result.size());
+  EXPECT_THAT(result.ids, IsEmpty());
+}
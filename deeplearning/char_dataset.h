@@ -0,0 +1,99 @@
+#ifndef DEEPLEARNING_CHAR_DATASET_H_
+#define DEEPLEARNING_CHAR_DATASET_H_
+
+// Character-level examples from a newline-separated word list such as
+// tutorials/data/names.txt, as in the makemore notebook.
+//
+// The file is memory-mapped read-only and never copied or split into strings:
+// every byte is one example, whose target is that byte ('\n' being the end
+// token) and whose context is the preceding bytes of the same word. Sampling
+// a minibatch only reads a few bytes around each sampled offset.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "absl/random/random.h"
+
+class CharDataset {
+ public:
+  // Token 0 ('.') marks both the start and the end of a word.
+  static constexpr int kVocabSize = 27;
+
+  static int token(char c) { return c == '\n' ? 0 : c - 'a' + 1; }
+  static char character(int token) { return token == 0 ? '.' : 'a' + token - 1; }
+
+  explicit CharDataset(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      throw std::runtime_error("Cannot read " + path);
+    }
+    size_ = st.st_size;
+    void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) throw std::runtime_error("Cannot map " + path);
+    data_ = static_cast<const char*>(addr);
+
+    for (char c : text()) {
+      if (c != '\n' && (c < 'a' || c > 'z')) {
+        ::munmap(const_cast<char*>(data_), size_);
+        throw std::runtime_error(path + " is not a lowercase word list");
+      }
+    }
+  }
+
+  ~CharDataset() { ::munmap(const_cast<char*>(data_), size_); }
+
+  CharDataset(const CharDataset&) = delete;
+  CharDataset& operator=(const CharDataset&) = delete;
+
+  std::string_view text() const { return {data_, size_}; }
+
+  // One example per byte, plus the end of the last word if the file doesn't
+  // end with a newline.
+  size_t numExamples() const {
+    return data_[size_ - 1] == '\n' ? size_ : size_ + 1;
+  }
+
+  // Writes the `context.size()` tokens preceding example i (padded with the
+  // start token at the beginning of a word) and returns its target token.
+  int32_t example(size_t i, std::span<int32_t> context) const {
+    const size_t block_size = context.size();
+    size_t n = 0;
+    while (n < block_size && n < i && data_[i - n - 1] != '\n') ++n;
+    for (size_t j = 0; j < block_size - n; ++j) context[j] = 0;
+    for (size_t j = 0; j < n; ++j) {
+      context[block_size - n + j] = token(data_[i - n + j]);
+    }
+    return i < size_ ? token(data_[i]) : 0;
+  }
+
+  // Fills preallocated buffers with uniformly sampled examples: `contexts`
+  // holds block_size tokens for each of the targets.size() examples.
+  void sampleBatch(absl::BitGen& gen,
+                   std::span<int32_t> contexts,
+                   std::span<int32_t> targets) const {
+    const size_t block_size = contexts.size() / targets.size();
+    for (size_t b = 0; b < targets.size(); ++b) {
+      const size_t i = absl::Uniform<size_t>(gen, 0, numExamples());
+      targets[b] = example(i, contexts.subspan(b * block_size, block_size));
+    }
+  }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+#endif  // DEEPLEARNING_CHAR_DATASET_H_
@@ -0,0 +1,62 @@
+#include "char_dataset.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+using ::testing::ElementsAre;
+
+namespace {
+
+std::string writeTempFile(const std::string& name, const std::string& text) {
+  const std::string path = ::testing::TempDir() + "/" + name;
+  std::ofstream(path) << text;
+  return path;
+}
+
+}  // namespace
+
+TEST(CharDatasetTest, ExamplesFollowMakemore) {
+  // Without a trailing newline, the last word still gets its end example.
+  const CharDataset dataset(writeTempFile("names.txt", "emma\nav"));
+  EXPECT_EQ(8, dataset.numExamples());
+
+  std::vector<int32_t> context(3);
+  // ... -> e
+  EXPECT_EQ(CharDataset::token('e'), dataset.example(0, context));
+  EXPECT_THAT(context, ElementsAre(0, 0, 0));
+  // .em -> m
+  EXPECT_EQ(CharDataset::token('m'), dataset.example(2, context));
+  EXPECT_THAT(context, ElementsAre(0, 5, 13));
+  // mma -> .
+  EXPECT_EQ(0, dataset.example(4, context));
+  EXPECT_THAT(context, ElementsAre(13, 13, 1));
+  // Contexts restart at a word boundary: ... -> a
+  EXPECT_EQ(CharDataset::token('a'), dataset.example(5, context));
+  EXPECT_THAT(context, ElementsAre(0, 0, 0));
+  // .av -> .
+  EXPECT_EQ(0, dataset.example(7, context));
+  EXPECT_THAT(context, ElementsAre(0, 1, 22));
+}
+
+TEST(CharDatasetTest, SampleBatchFillsBuffers) {
+  const CharDataset dataset(writeTempFile("ab.txt", "ab\n"));
+  absl::BitGen gen;
+  std::vector<int32_t> contexts(2 * 64, -1);
+  std::vector<int32_t> targets(64, -1);
+  dataset.sampleBatch(gen, contexts, targets);
+  for (size_t b = 0; b < targets.size(); ++b) {
+    const int32_t prev = contexts[2 * b + 1];
+    // The only bigrams are .a, ab and b.
+    EXPECT_EQ(prev == 0 ? 1 : prev == 1 ? 2 : 0, targets[b]);
+  }
+}
+
+TEST(CharDatasetTest, RejectsInvalidFiles) {
+  EXPECT_THROW(CharDataset("/nonexistent/names.txt"), std::runtime_error);
+  EXPECT_THROW(CharDataset(writeTempFile("upper.txt", "Emma\n")),
+               std::runtime_error);
+}
@@ -0,0 +1,234 @@
+#ifndef DEEPLEARNING_COMPILED_GRAPH_H_
+#define DEEPLEARNING_COMPILED_GRAPH_H_
+
+// Capture-and-replay for scalar graphs whose structure is fixed from one
+// training step to the next.
+//
+// The graph is recorded once as usual (on a Tape, or through ExprTree::reg),
+// then compiled into a flat instruction stream over preallocated value and
+// gradient buffers. Each later step only overwrites the inputs and replays
+// forward() and backward(): no nodes, labels or buffers are allocated.
+//
+// Compilation also fuses chains of elementwise ops whose intermediate result
+// has no other use, which is the shape of every neuron:
+//   a * b + c        -> MulAdd
+//   tanh(a + b)      -> AddTanh
+//   tanh(a * b + c)  -> MulAddTanh
+// Fused intermediates get no buffer slot, and their values and gradients are
+// not observable.
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "micrograd.h"
+
+enum class Opcode : uint8_t { Add, Mul, Tanh, MulAdd, AddTanh, MulAddTanh };
+
+// dst = op(a, b, c), where unused operands are ignored.
+struct Instr {
+  Opcode op;
+  uint32_t dst, a, b, c;
+};
+
+template <typename T>
+class CompiledGraph {
+ public:
+  static constexpr uint32_t kNoSlot = ~uint32_t{0};
+
+  // Compiles the part of `tape` that `root` depends on.
+  CompiledGraph(const Tape<T>& tape, NodeId root) { compile(tape, root); }
+
+  CompiledGraph(const ExprTree<T>& tree, const std::string& root_label) {
+    compile(tree.tape, tree.ids.at(root_label));
+  }
+
+  bool hasSlot(NodeId id) const {
+    return id < slots.size() && slots[id] != kNoSlot;
+  }
+
+  // Input (or any other materialized node) to overwrite before forward().
+  T& data(NodeId id) { return values[slot(id)]; }
+  T data(NodeId id) const { return values[slot(id)]; }
+  T grad(NodeId id) const { return grads[slot(id)]; }
+
+  void forward() {
+    T* v = values.data();
+    for (const Instr& in : program) {
+      switch (in.op) {
+        case Opcode::Add:
+          v[in.dst] = v[in.a] + v[in.b];
+          break;
+        case Opcode::Mul:
+          v[in.dst] = v[in.a] * v[in.b];
+          break;
+        case Opcode::Tanh:
+          v[in.dst] = tanhOf(v[in.a]);
+          break;
+        case Opcode::MulAdd:
+          v[in.dst] = v[in.a] * v[in.b] + v[in.c];
+          break;
+        case Opcode::AddTanh:
+          v[in.dst] = tanhOf(v[in.a] + v[in.b]);
+          break;
+        case Opcode::MulAddTanh:
+          v[in.dst] = tanhOf(v[in.a] * v[in.b] + v[in.c]);
+          break;
+      }
+    }
+  }
+
+  // Zeroes all gradients and backpropagates from the root.
+  void backward() {
+    std::fill(grads.begin(), grads.end(), T{0});
+    const T* v = values.data();
+    T* g = grads.data();
+    g[root_slot] = 1;
+    for (auto it = program.rbegin(); it != program.rend(); ++it) {
+      const Instr& in = *it;
+      const T gd = g[in.dst];
+      switch (in.op) {
+        case Opcode::Add:
+          g[in.a] += gd;
+          g[in.b] += gd;
+          break;
+        case Opcode::Mul:
+          g[in.a] += gd * v[in.b];
+          g[in.b] += gd * v[in.a];
+          break;
+        case Opcode::Tanh:
+          g[in.a] += gd * (1 - v[in.dst] * v[in.dst]);
+          break;
+        case Opcode::MulAdd:
+          g[in.a] += gd * v[in.b];
+          g[in.b] += gd * v[in.a];
+          g[in.c] += gd;
+          break;
+        case Opcode::AddTanh: {
+          const T d = gd * (1 - v[in.dst] * v[in.dst]);
+          g[in.a] += d;
+          g[in.b] += d;
+          break;
+        }
+        case Opcode::MulAddTanh: {
+          const T d = gd * (1 - v[in.dst] * v[in.dst]);
+          g[in.a] += d * v[in.b];
+          g[in.b] += d * v[in.a];
+          g[in.c] += d;
+          break;
+        }
+      }
+    }
+  }
+
+  std::vector<Instr> program;
+  std::vector<T> values;
+  std::vector<T> grads;
+  // Buffer slot of each tape node, or kNoSlot if it was fused away or isn't
+  // needed for the root.
+  std::vector<uint32_t> slots;
+  uint32_t root_slot = kNoSlot;
+
+ private:
+  uint32_t slot(NodeId id) const {
+    if (!hasSlot(id)) {
+      throw std::out_of_range("Node " + std::to_string(id) +
+                              " is not materialized in the compiled graph");
+    }
+    return slots[id];
+  }
+
+  void compile(const Tape<T>& tape, NodeId root) {
+    const auto& nodes = tape.nodes;
+    std::vector<bool> reachable(root + 1);
+    reachable[root] = true;
+    std::vector<uint32_t> uses(root + 1);
+    for (NodeId id = root + 1; id-- > 0;) {
+      if (!reachable[id]) continue;
+      for (int i = 0; i < numChildren(nodes[id].op); ++i) {
+        reachable[nodes[id].children[i]] = true;
+        ++uses[nodes[id].children[i]];
+      }
+    }
+
+    // A node can be folded into its consumer if nothing else reads it.
+    auto single_use = [&](NodeId id) {
+      return id != root && uses[id] == 1;
+    };
+    std::vector<bool> fused(root + 1);
+    for (NodeId id = 0; id <= root; ++id) {
+      if (!reachable[id]) continue;
+      const auto& node = nodes[id];
+      const auto& c = node.children;
+      if (node.op == ExprOp::Add) {
+        // Prefer the second operand, which is where a running sum of
+        // products keeps its newest term.
+        for (int i : {1, 0}) {
+          if (nodes[c[i]].op == ExprOp::Mult && single_use(c[i])) {
+            fused[c[i]] = true;
+            break;
+          }
+        }
+      } else if (node.op == ExprOp::Tanh) {
+        if (nodes[c[0]].op == ExprOp::Add && single_use(c[0])) {
+          fused[c[0]] = true;
+        }
+      }
+    }
+
+    slots.assign(tape.size(), kNoSlot);
+    for (NodeId id = 0; id <= root; ++id) {
+      if (!reachable[id] || fused[id]) continue;
+      slots[id] = values.size();
+      values.push_back(nodes[id].data);
+    }
+    grads.assign(values.size(), T{0});
+    root_slot = slots[root];
+
+    for (NodeId id = 0; id <= root; ++id) {
+      if (!reachable[id] || fused[id]) continue;
+      const auto& node = nodes[id];
+      if (node.op == ExprOp::Leaf) continue;
+      program.push_back(lower(nodes, fused, id));
+    }
+  }
+
+  // The instruction computing `id`, absorbing any fused operands.
+  Instr lower(const std::vector<TapeNode<T>>& nodes,
+              const std::vector<bool>& fused,
+              NodeId id) const {
+    const auto& c = nodes[id].children;
+    const uint32_t dst = slots[id];
+    switch (nodes[id].op) {
+      case ExprOp::Mult:
+        return {Opcode::Mul, dst, slots[c[0]], slots[c[1]], kNoSlot};
+      case ExprOp::Add:
+        for (int i : {1, 0}) {
+          if (fused[c[i]]) {
+            const auto& m = nodes[c[i]].children;
+            return {
+                Opcode::MulAdd, dst, slots[m[0]], slots[m[1]], slots[c[1 - i]]};
+          }
+        }
+        return {Opcode::Add, dst, slots[c[0]], slots[c[1]], kNoSlot};
+      case ExprOp::Tanh:
+        if (fused[c[0]]) {
+          const Instr sum = lower(nodes, fused, c[0]);
+          const Opcode op =
+              sum.op == Opcode::MulAdd ? Opcode::MulAddTanh : Opcode::AddTanh;
+          return {op, dst, sum.a, sum.b, sum.c};
+        }
+        return {Opcode::Tanh, dst, slots[c[0]], kNoSlot, kNoSlot};
+      case ExprOp::Leaf:
+        break;
+    }
+    assert(false);
+    return {};
+  }
+};
+
+#endif  // DEEPLEARNING_COMPILED_GRAPH_H_
@@ -0,0 +1,97 @@
+#include "compiled_graph.h"
+
+#include <gtest/gtest.h>
+
+#include "gmock/gmock.h"
+#include "micrograd.h"
+
+namespace {
+
+// n-input neuron, as in gen_dot_graph.cpp: tanh(sum_i x_i * w_i + b).
+NodeId buildNeuron(Tape<double>& tape, int n, std::vector<NodeId>& inputs) {
+  NodeId sum = tape.leaf(0.3);
+  for (int i = 0; i < n; ++i) {
+    const NodeId x = tape.leaf(0.1 * i);
+    const NodeId w = tape.leaf(-0.2 + 0.05 * i);
+    inputs.push_back(x);
+    sum = tape.add(sum, tape.mul(x, w));
+  }
+  return tape.tanh(sum);
+}
+
+void expectMatchesTape(Tape<double>& tape,
+                       NodeId root,
+                       const CompiledGraph<double>& compiled) {
+  tape.zeroGrad();
+  tape.forward(root);
+  tape.backward(root);
+  EXPECT_DOUBLE_EQ(tape.nodes[root].data, compiled.data(root));
+  for (NodeId id = 0; id <= root; ++id) {
+    if (!compiled.hasSlot(id)) continue;
+    EXPECT_NEAR(tape.nodes[id].data, compiled.data(id), 1e-14) << id;
+    EXPECT_NEAR(tape.nodes[id].grad, compiled.grad(id), 1e-14) << id;
+  }
+}
+
+}  // namespace
+
+TEST(CompiledGraphTest, NeuronFusesIntoMultiplyAdds) {
+  Tape<double> tape;
+  std::vector<NodeId> inputs;
+  const NodeId root = buildNeuron(tape, 4, inputs);
+  CompiledGraph<double> compiled(tape, root);
+
+  // Three MulAdds, then the last multiply-add fused with the tanh.
+  ASSERT_EQ(4, compiled.program.size());
+  EXPECT_EQ(Opcode::MulAdd, compiled.program[0].op);
+  EXPECT_EQ(Opcode::MulAddTanh, compiled.program.back().op);
+  // Products are fused away, and so is the final sum feeding the tanh.
+  EXPECT_FALSE(compiled.hasSlot(root - 1));
+
+  compiled.forward();
+  compiled.backward();
+  expectMatchesTape(tape, root, compiled);
+}
+
+TEST(CompiledGraphTest, ReplayOverNewInputs) {
+  Tape<double> tape;
+  std::vector<NodeId> inputs;
+  const NodeId root = buildNeuron(tape, 8, inputs);
+  CompiledGraph<double> compiled(tape, root);
+
+  for (int step = 0; step < 3; ++step) {
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      const double x = std::sin(step + 0.5 * i);
+      compiled.data(inputs[i]) = x;
+      tape.nodes[inputs[i]].data = x;
+    }
+    compiled.forward();
+    compiled.backward();
+    expectMatchesTape(tape, root, compiled);
+  }
+}
+
+TEST(CompiledGraphTest, SharedNodesAreNotFused) {
+  // The graph from BackpropWithSharedNodes, plus a tanh of a shared sum.
+  ExprTree<double> tree;
+  tree.reg(Value(-2.), "a");
+  tree.reg(Value(3.), "b");
+  tree.reg(tree("a") * tree("b"), "d");
+  tree.reg(tree("a") + tree("b"), "e");
+  tree.reg(tree("d") * tree("e"), "f");
+  tree.reg(tree("f") + tree("e"), "g");
+  tree.reg(tree("g").tanh(), "h");
+
+  CompiledGraph<double> compiled(tree, "h");
+  compiled.forward();
+  compiled.backward();
+  for (const char* label : {"a", "b", "d", "e", "h"}) {
+    EXPECT_TRUE(compiled.hasSlot(tree.ids.at(label))) << label;
+  }
+  // f is only used by g, and g only by h.
+  EXPECT_FALSE(compiled.hasSlot(tree.ids.at("f")));
+  EXPECT_FALSE(compiled.hasSlot(tree.ids.at("g")));
+  EXPECT_THROW(compiled.grad(tree.ids.at("f")), std::out_of_range);
+
+  expectMatchesTape(tree.tape, tree.ids.at("h"), compiled);
+}
@@ -0,0 +1,102 @@
+#ifndef DEEPLEARNING_DATA_PARALLEL_H_
+#define DEEPLEARNING_DATA_PARALLEL_H_
+
+// Data-parallel gradient computation over TensorTape models.
+//
+// A minibatch is split into a fixed number of shards, each with its own
+// replica of the model graph. Replicas read the parameters of replica 0 in
+// place (TensorTape::share), so there is one copy of the weights, and each
+// shard runs forward and backward on whichever worker picks it up.
+//
+// Shard gradients are then summed by a pairwise tree over shard indices:
+// (0 + 1), (2 + 3), ..., then (0 + 2), ... The order of every floating-point
+// addition depends only on the number of shards, never on the number of
+// threads or on scheduling, so results are bit-identical across runs and
+// thread counts for a given shard count.
+
+#include <cassert>
+#include <functional>
+#include <vector>
+
+#include "systems/work_stealing_pool.h"
+#include "tensor.h"
+
+// `Model` holds a TensorTape `tape`, its parameter leaves `params` and its
+// scalar `loss` node, like the models in makemore.cpp.
+template <typename Model>
+class DataParallel {
+ public:
+  using T = typename decltype(Model::tape)::Scalar;
+
+  // Builds one replica per shard. `build` must produce the same graph every
+  // time, up to the input data.
+  DataParallel(const std::function<Model()>& build, size_t num_shards) {
+    assert(num_shards > 0);
+    replicas.reserve(num_shards);
+    for (size_t s = 0; s < num_shards; ++s) replicas.push_back(build());
+
+    const Model& master = replicas[0];
+    for (size_t s = 1; s < num_shards; ++s) {
+      Model& replica = replicas[s];
+      for (size_t i = 0; i < master.params.size(); ++i) {
+        replica.tape.share(replica.params[i],
+                           master.tape.value(master.params[i]));
+      }
+    }
+  }
+
+  size_t numShards() const { return replicas.size(); }
+
+  // The replica that owns the parameters. Update them in place between steps
+  // through master().tape.mutableValue().
+  Model& master() { return replicas[0]; }
+
+  // Runs forward and backward on every shard, after `fill(shard, replica)`
+  // has loaded that shard's inputs, and reduces the gradients. Returns the
+  // mean loss over shards; grad(i) is then the mean gradient of params[i].
+  // `fill` runs concurrently for different shards.
+  T step(WorkStealingPool& pool,
+         const std::function<void(size_t, Model&)>& fill) {
+    pool.parallelFor(replicas.size(), [&](size_t s, size_t) {
+      Model& replica = replicas[s];
+      fill(s, replica);
+      replica.tape.forward(replica.loss);
+      replica.tape.zeroGrad();
+      replica.tape.backward(replica.loss);
+    });
+
+    const size_t num_params = replicas[0].params.size();
+    for (size_t stride = 1; stride < replicas.size(); stride *= 2) {
+      const size_t num_pairs =
+          (replicas.size() - stride + 2 * stride - 1) / (2 * stride);
+      pool.parallelFor(num_pairs * num_params, [&](size_t task, size_t) {
+        const size_t dst = task / num_params * 2 * stride;
+        const size_t i = task % num_params;
+        replicaGrad(dst, i) += replicaGrad(dst + stride, i);
+      });
+    }
+
+    const T scale = T{1} / replicas.size();
+    for (size_t i = 0; i < num_params; ++i) replicaGrad(0, i) *= scale;
+
+    // Shard losses are few, so sum them in shard order.
+    T loss = 0;
+    for (const Model& replica : replicas) {
+      loss += replica.tape.value(replica.loss)(0, 0);
+    }
+    return loss * scale;
+  }
+
+  const Matrix<T>& grad(size_t i) const {
+    return replicas[0].tape.grad(replicas[0].params[i]);
+  }
+
+  std::vector<Model> replicas;
+
+ private:
+  Matrix<T>& replicaGrad(size_t shard, size_t i) {
+    return replicas[shard].tape.mutableGrad(replicas[shard].params[i]);
+  }
+};
+
+#endif  // DEEPLEARNING_DATA_PARALLEL_H_
@@ -0,0 +1,111 @@
+#include "data_parallel.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "gmock/gmock.h"
+
+namespace {
+
+constexpr int kFeatures = 3;
+constexpr int kOutputs = 4;
+
+struct Model {
+  TensorTape<double> tape;
+  std::vector<NodeId> params;
+  NodeId x;
+  NodeId loss;
+};
+
+// loss = mean(tanh(x w + b)) over a batch of `rows` inputs.
+Model buildModel(int rows) {
+  Model m;
+  auto& t = m.tape;
+  m.x = t.leaf(Matrix<double>::Zero(rows, kFeatures));
+  Matrix<double> w(kFeatures, kOutputs);
+  for (int i = 0; i < w.size(); ++i) w.data()[i] = std::sin(i + 1.0);
+  const NodeId nw = t.leaf(w);
+  const NodeId nb = t.leaf(Matrix<double>::Constant(1, kOutputs, 0.1));
+  m.params = {nw, nb};
+  m.loss = t.mean(t.tanh(t.add(t.matmul(m.x, nw), nb)));
+  return m;
+}
+
+// Row r of the full batch.
+double input(int r, int c) { return std::cos(0.7 * r + 1.3 * c); }
+
+void fillShard(size_t shard, int rows_per_shard, Model& m) {
+  auto& x = m.tape.mutableValue(m.x);
+  for (int r = 0; r < rows_per_shard; ++r) {
+    for (int c = 0; c < kFeatures; ++c) {
+      x(r, c) = input(shard * rows_per_shard + r, c);
+    }
+  }
+}
+
+}  // namespace
+
+TEST(DataParallelTest, MatchesFullBatchGradient) {
+  constexpr int kShards = 5;
+  constexpr int kRowsPerShard = 3;
+  DataParallel<Model> dp([] { return buildModel(kRowsPerShard); }, kShards);
+  WorkStealingPool pool(2);
+  const double loss = dp.step(pool, [](size_t shard, Model& m) {
+    fillShard(shard, kRowsPerShard, m);
+  });
+
+  Model full = buildModel(kShards * kRowsPerShard);
+  fillShard(0, kShards * kRowsPerShard, full);
+  full.tape.forward(full.loss);
+  full.tape.backward(full.loss);
+
+  EXPECT_NEAR(full.tape.value(full.loss)(0, 0), loss, 1e-14);
+  for (size_t i = 0; i < full.params.size(); ++i) {
+    EXPECT_TRUE(dp.grad(i).isApprox(full.tape.grad(full.params[i]), 1e-12));
+  }
+}
+
+TEST(DataParallelTest, BitIdenticalAcrossThreadCounts) {
+  constexpr int kShards = 6;
+  constexpr int kRowsPerShard = 2;
+  auto run = [&](size_t num_threads) {
+    DataParallel<Model> dp([] { return buildModel(kRowsPerShard); }, kShards);
+    WorkStealingPool pool(num_threads);
+    // A few SGD steps, so that differences would compound.
+    for (int step = 0; step < 3; ++step) {
+      dp.step(pool, [](size_t shard, Model& m) {
+        fillShard(shard, kRowsPerShard, m);
+      });
+      Model& master = dp.master();
+      for (size_t i = 0; i < master.params.size(); ++i) {
+        master.tape.mutableValue(master.params[i]) -= 0.5 * dp.grad(i);
+      }
+    }
+    std::vector<Matrix<double>> grads;
+    for (size_t i = 0; i < dp.master().params.size(); ++i) {
+      grads.push_back(dp.grad(i));
+    }
+    return grads;
+  };
+
+  const auto expected = run(1);
+  for (size_t num_threads : {2, 3, 8}) {
+    const auto actual = run(num_threads);
+    for (size_t i = 0; i < expected.size(); ++i) {
+      // Exact equality, not approximate.
+      EXPECT_EQ(expected[i], actual[i]);
+    }
+  }
+}
+
+TEST(DataParallelTest, ReplicasShareParameterStorage) {
+  DataParallel<Model> dp([] { return buildModel(1); }, 3);
+  Model& master = dp.master();
+  master.tape.mutableValue(master.params[1]).setConstant(42);
+  for (const Model& replica : dp.replicas) {
+    EXPECT_EQ(42, replica.tape.value(replica.params[1])(0, 0));
+    EXPECT_EQ(&master.tape.value(master.params[1]),
+              &replica.tape.value(replica.params[1]));
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef DEEPLEARNING_DUAL_H_
+#define DEEPLEARNING_DUAL_H_
+
+// Forward-mode automatic differentiation with dual numbers.
+//
+// A Dual carries a value and its derivative (tangent) along one direction.
+// Evaluating any function built from +, -, * and tanh on Duals seeded with
+// tangent v yields f(x) together with the Jacobian-vector product J v, in a
+// single pass with no graph and no allocation. One pass per input direction
+// is cheaper than reverse mode when there are few inputs and many outputs.
+//
+// Dual is also a scalar for Tape, Value and ExprTree. Running reverse mode on
+// Duals differentiates the gradient along the tangent direction, so the
+// tangents of the resulting grads are a Hessian-vector product:
+//
+//   ExprTree<Dual<double>> tree;
+//   tree.reg(Value(Dual(x, v)), "x");
+//   ...
+//   tree.runBackprop("loss");
+//   tree("x").grad.value;    // df/dx
+//   tree("x").grad.tangent;  // (H v)_x
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+template <typename T>
+struct Dual {
+  // Implicit, so that constants (such as the 1 seeding backprop) can be mixed
+  // with Duals: a constant has no tangent.
+  constexpr Dual(T value = 0, T tangent = 0)
+      : value(value), tangent(tangent) {}
+
+  friend constexpr Dual operator+(const Dual& a, const Dual& b) {
+    return {a.value + b.value, a.tangent + b.tangent};
+  }
+  friend constexpr Dual operator-(const Dual& a, const Dual& b) {
+    return {a.value - b.value, a.tangent - b.tangent};
+  }
+  friend constexpr Dual operator*(const Dual& a, const Dual& b) {
+    return {a.value * b.value, a.tangent * b.value + a.value * b.tangent};
+  }
+  Dual& operator+=(const Dual& other) { return *this = *this + other; }
+  Dual& operator*=(const Dual& other) { return *this = *this * other; }
+
+  friend Dual tanh(const Dual& a) {
+    using std::tanh;
+    const T t = tanh(a.value);
+    return {t, (1 - t * t) * a.tangent};
+  }
+
+  friend constexpr bool operator==(const Dual&, const Dual&) = default;
+
+  T value;
+  T tangent;
+};
+
+// Evaluates f (a callable on std::array<Dual<T>, N>) at x with tangents v.
+// Returns whatever f returns: a Dual whose tangent is the directional
+// derivative, or a container of them holding J v.
+template <typename T, size_t N, typename F>
+auto jvp(F&& f, const std::array<T, N>& x, const std::array<T, N>& v) {
+  std::array<Dual<T>, N> args;
+  for (size_t i = 0; i < N; ++i) args[i] = {x[i], v[i]};
+  return std::forward<F>(f)(args);
+}
+
+#endif  // DEEPLEARNING_DUAL_H_
@@ -0,0 +1,89 @@
+#include "dual.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cmath>
+
+#include "gmock/gmock.h"
+#include "micrograd.h"
+
+TEST(DualTest, DerivativeOfNeuron) {
+  // d/dx tanh(x * w + b) = (1 - o^2) w.
+  const double x = 0.7, w = -1.3, b = 0.2;
+  const Dual<double> o = tanh(Dual(x, 1.0) * w + b);
+  EXPECT_DOUBLE_EQ(std::tanh(x * w + b), o.value);
+  EXPECT_DOUBLE_EQ((1 - o.value * o.value) * w, o.tangent);
+}
+
+TEST(DualTest, JvpMatchesReverseMode) {
+  // f(a, b, c) = tanh(a * b + c) * a, differentiated along v.
+  const std::array<double, 3> x = {0.5, -2.0, 0.3};
+  const std::array<double, 3> v = {1.0, 0.25, -0.5};
+  const Dual<double> forward = jvp(
+      [](const auto& in) { return tanh(in[0] * in[1] + in[2]) * in[0]; },
+      x,
+      v);
+
+  Tape<double> tape;
+  const NodeId a = tape.leaf(x[0]);
+  const NodeId b = tape.leaf(x[1]);
+  const NodeId c = tape.leaf(x[2]);
+  const NodeId f = tape.mul(tape.tanh(tape.add(tape.mul(a, b), c)), a);
+  tape.backward(f);
+
+  EXPECT_DOUBLE_EQ(tape.nodes[f].data, forward.value);
+  EXPECT_NEAR(tape.nodes[a].grad * v[0] + tape.nodes[b].grad * v[1] +
+                  tape.nodes[c].grad * v[2],
+              forward.tangent,
+              1e-15);
+}
+
+TEST(DualTest, TapeReplaysJvp) {
+  Tape<Dual<double>> tape;
+  const NodeId x = tape.leaf(Dual(1.0, 1.0));
+  const NodeId w = tape.leaf(2.0);
+  const NodeId y = tape.tanh(tape.mul(x, w));
+  for (double input : {-0.5, 0.0, 0.5}) {
+    tape.nodes[x].data.value = input;
+    tape.forward(y);
+    const double t = std::tanh(2 * input);
+    EXPECT_DOUBLE_EQ(t, tape.nodes[y].data.value);
+    EXPECT_DOUBLE_EQ((1 - t * t) * 2, tape.nodes[y].data.tangent);
+  }
+}
+
+TEST(DualTest, HessianVectorProductThroughExprTree) {
+  // f(a, b) = a * a * b has gradient (2ab, a^2) and Hessian
+  // [[2b, 2a], [2a, 0]].
+  const double a = 1.5, b = -2.0;
+  const std::array<double, 2> v = {0.5, 3.0};
+  ExprTree<Dual<double>> tree;
+  tree.reg(Value(Dual(a, v[0])), "a");
+  tree.reg(Value(Dual(b, v[1])), "b");
+  tree.reg(tree("a") * tree("a"), "a2");
+  tree.reg(tree("a2") * tree("b"), "f");
+  tree.runBackprop("f");
+
+  EXPECT_DOUBLE_EQ(a * a * b, tree("f").data.value);
+  EXPECT_DOUBLE_EQ(2 * a * b, tree("a").grad.value);
+  EXPECT_DOUBLE_EQ(a * a, tree("b").grad.value);
+  EXPECT_DOUBLE_EQ(2 * b * v[0] + 2 * a * v[1], tree("a").grad.tangent);
+  EXPECT_DOUBLE_EQ(2 * a * v[0], tree("b").grad.tangent);
+}
+
+TEST(DualTest, HessianVectorProductThroughTanh) {
+  // f(x) = tanh(x * x): compare H v with a central difference of f'.
+  auto grad = [](double x) {
+    const double t = std::tanh(x * x);
+    return (1 - t * t) * 2 * x;
+  };
+  const double x = 0.6, v = 2.0, h = 1e-6;
+  Tape<Dual<double>> tape;
+  const NodeId nx = tape.leaf(Dual(x, v));
+  tape.backward(tape.tanh(tape.mul(nx, nx)));
+  EXPECT_DOUBLE_EQ(grad(x), tape.nodes[nx].grad.value);
+  EXPECT_NEAR((grad(x + h) - grad(x - h)) / (2 * h) * v,
+              tape.nodes[nx].grad.tangent,
+              1e-8);
+}
@@ -2,6 +2,9 @@
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/graph_traits.hpp>
 #include <boost/graph/graphviz.hpp>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "micrograd.h"
 
@@ -13,6 +16,8 @@ struct NodeProperties {
 
 std::string to_string(ExprOp op) {
   switch (op) {
+    case ExprOp::Leaf:
+      return "";
     case ExprOp::Add:
       return "+";
     case ExprOp::Mult:
@@ -32,33 +37,39 @@ using Graph = boost::adjacency_list<boost::vecS,       // OutEdgeList
 
 using Vertex = boost::graph_traits<Graph>::vertex_descriptor;
 
+template <typename T>
+std::string vertex_label(const ExprTree<T>& tree, NodeId id) {
+  const Value<T> v = tree(id);
+  const std::string& label = tree.labels[id];
+  return (label.empty() ? std::to_string(v.data) : label) +
+         "\nvalue: " + std::to_string(v.data) +
+         "\ngrad: " + std::to_string(v.grad);
+}
+
 template <typename T>
 void build_value_graph_recursive(
-    const ExprTree<T>& tree,     // Pass ExprTree as a parameter
-    const std::string& v_label,  // Use string labels
-    std::unordered_map<std::string, Vertex>&
-        label_to_vertex,  // Map string labels to vertices
+    const ExprTree<T>& tree,  // Pass ExprTree as a parameter
+    NodeId v_id,
+    std::unordered_map<NodeId, Vertex>&
+        id_to_vertex,  // Map tape nodes to vertices
     Graph& g,
-    std::unordered_set<std::string>& visited) {
-  if (visited.contains(v_label)) {
+    std::unordered_set<NodeId>& visited) {
+  if (visited.contains(v_id)) {
     return;
   }
-  visited.insert(v_label);
+  visited.insert(v_id);
 
-  if (!label_to_vertex.contains(v_label)) {
+  if (!id_to_vertex.contains(v_id)) {
     Vertex current_v = boost::add_vertex(g);
-    const Value<T>& v = tree(v_label);  // Access Value object from ExprTree
-    g[current_v].label = (v.label.empty() ? std::to_string(v.data) : v.label) +
-                         "\nvalue: " + std::to_string(v.data) +
-                         "\ngrad: " + std::to_string(v.grad);
+    g[current_v].label = vertex_label(tree, v_id);
     g[current_v].op = "";
-    label_to_vertex[v_label] = current_v;
+    id_to_vertex[v_id] = current_v;
   }
-  Vertex current_v = label_to_vertex[v_label];
+  Vertex current_v = id_to_vertex[v_id];
 
-  const Value<T>& v = tree(v_label);  // Access Value object from ExprTree
+  const Value<T> v = tree(v_id);  // Access Value object from ExprTree
 
-  if (v.children.empty()) {
+  if (v.op == ExprOp::Leaf) {
     return;
   }
 
@@ -68,27 +79,23 @@ void build_value_graph_recursive(
   boost::add_edge(op_v, current_v, g);
 
   // Edges from operands to the operator
-  for (const std::string& child_label : v.children) {
-    if (!label_to_vertex.contains(child_label)) {
+  for (int i = 0; i < numChildren(v.op); ++i) {
+    const NodeId child_id = v.children[i];
+    if (!id_to_vertex.contains(child_id)) {
       Vertex child_v = boost::add_vertex(g);
-      const Value<T>& child =
-          tree(child_label);  // Access Value object from ExprTree
-      g[child_v].label =
-          (child.label.empty() ? std::to_string(child.data) : child.label) +
-          "\nvalue: " + std::to_string(child.data) +
-          "\ngrad: " + std::to_string(child.grad);
+      g[child_v].label = vertex_label(tree, child_id);
       g[child_v].op = "";
-      label_to_vertex[child_label] = child_v;
-      build_value_graph_recursive(
-          tree, child_label, label_to_vertex, g, visited);
+      id_to_vertex[child_id] = child_v;
+      build_value_graph_recursive(tree, child_id, id_to_vertex, g, visited);
     }
     boost::add_edge(
-        label_to_vertex[child_label], op_v, g);  // Operand points to operator
+        id_to_vertex[child_id], op_v, g);  // Operand points to operator
   }
 
   // Recursively process children AFTER creating the operator and operand edges
-  for (const std::string& child_label : v.children) {
-    build_value_graph_recursive(tree, child_label, label_to_vertex, g, visited);
+  for (int i = 0; i < numChildren(v.op); ++i) {
+    build_value_graph_recursive(
+        tree, v.children[i], id_to_vertex, g, visited);
   }
 }
 
@@ -96,9 +103,10 @@ template <typename T>
 Graph build_value_graph_with_ops(const ExprTree<T>& tree,
                                  const std::string& root_label) {
   Graph g;
-  std::unordered_map<std::string, Vertex> label_to_vertex;
-  std::unordered_set<std::string> visited;
-  build_value_graph_recursive(tree, root_label, label_to_vertex, g, visited);
+  std::unordered_map<NodeId, Vertex> id_to_vertex;
+  std::unordered_set<NodeId> visited;
+  build_value_graph_recursive(
+      tree, tree.ids.at(root_label), id_to_vertex, g, visited);
   return g;
 }
 
@@ -0,0 +1,363 @@
+#ifndef DEEPLEARNING_GRAPH_EXPORT_H_
+#define DEEPLEARNING_GRAPH_EXPORT_H_
+
+// Streaming export of the graph under a root, for graphs too large for the
+// boost::adjacency_list path in gen_dot_graph.cpp.
+//
+// The tape is already a graph, so nothing is copied into another structure:
+// two linear scans over node ids decide which nodes are shown, then each
+// writer walks those nodes once, formatting numbers with std::to_chars into a
+// buffer that is flushed to the stream in large blocks.
+//
+// Formats:
+//   DOT     one box per node (label or op, data, grad), and edges from
+//           operands to results.
+//   JSON    {"nodes": [{"id", "op", "label", "data", "grad", ...}],
+//            "edges": [[operand, result], ...]}, with null for NaN and
+//           infinite values, which JSON can't represent.
+//   Binary  little-endian on any host: "MGRF", u32 version (1), u32 num_nodes,
+//           u32 num_edges, then per node {u32 id, u8 op (ExprOp), u8 flags,
+//           f64 data, f64 grad}, then per edge {u32 operand, u32 result}.
+//           Labels are not included. For kCollapsed nodes, data is the id of
+//           the node they repeat.
+//
+// For large models, ExportOptions can stop expanding nodes beyond a depth, or
+// draw repeated subgraphs (e.g. identical neurons) once.
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "micrograd.h"
+
+struct ExportOptions {
+  // Nodes this many ops below the root are shown but their operands are not.
+  // Negative for no limit.
+  int max_depth = -1;
+  // If positive, a subgraph with the same structure (ops and shape, whatever
+  // its leaves) as one already shown is drawn as a single node referring to
+  // it, provided it has at least this many nodes counted as a tree.
+  size_t collapse_min_nodes = 0;
+  // Data and grad in DOT and JSON labels.
+  bool include_values = true;
+};
+
+template <typename T>
+class GraphExporter {
+ public:
+  // Binary node flags.
+  static constexpr uint8_t kTruncated = 1;  // Operands omitted (max_depth).
+  static constexpr uint8_t kCollapsed = 2;  // Repeats another node.
+
+  // `labels`, if given, is indexed by NodeId, and empty labels are ignored.
+  GraphExporter(const Tape<T>& tape,
+                NodeId root,
+                const ExportOptions& options = {},
+                std::span<const std::string> labels = {})
+      : tape_(tape), labels_(labels), options_(options) {
+    select(root);
+  }
+
+  GraphExporter(const ExprTree<T>& tree,
+                const std::string& root_label,
+                const ExportOptions& options = {})
+      : GraphExporter(
+            tree.tape, tree.ids.at(root_label), options, tree.labels) {}
+
+  size_t numNodes() const { return shown_.size(); }
+  size_t numEdges() const { return num_edges_; }
+
+  void writeDot(std::ostream& out) const {
+    Writer w(out);
+    w << "digraph G {\n  rankdir=LR;\n  node [shape=box];\n";
+    for (NodeId id : shown_) {
+      const Shown& s = state_[id];
+      w << "  n" << id << " [label=\"";
+      if (s.flags & kCollapsed) {
+        w << "same as n" << s.same_as << "\" style=dashed];\n";
+        continue;
+      }
+      writeName(w, id);
+      if (options_.include_values) {
+        w << "\\ndata " << double(tape_.nodes[id].data) << "\\ngrad "
+          << double(tape_.nodes[id].grad);
+      }
+      w << '"';
+      if (s.flags & kTruncated) w << " style=dashed";
+      w << "];\n";
+      forEachEdge(id, [&](NodeId child) {
+        w << "  n" << child << " -> n" << id << ";\n";
+      });
+    }
+    w << "}\n";
+  }
+
+  void writeJson(std::ostream& out) const {
+    Writer w(out);
+    w << "{\"nodes\":[";
+    const char* sep = "";
+    for (NodeId id : shown_) {
+      const Shown& s = state_[id];
+      const auto& node = tape_.nodes[id];
+      w << sep << "{\"id\":" << id << ",\"op\":\"" << opName(node.op) << '"';
+      sep = ",";
+      if (s.flags & kCollapsed) {
+        w << ",\"same_as\":" << s.same_as << '}';
+        continue;
+      }
+      if (id < labels_.size() && !labels_[id].empty()) {
+        w << ",\"label\":\"";
+        w.escaped(labels_[id]);
+        w << '"';
+      }
+      if (options_.include_values) {
+        w << ",\"data\":";
+        w.jsonNumber(node.data);
+        w << ",\"grad\":";
+        w.jsonNumber(node.grad);
+      }
+      if (s.flags & kTruncated) w << ",\"truncated\":true";
+      w << '}';
+    }
+    w << "],\"edges\":[";
+    sep = "";
+    for (NodeId id : shown_) {
+      forEachEdge(id, [&](NodeId child) {
+        w << sep << '[' << child << ',' << id << ']';
+        sep = ",";
+      });
+    }
+    w << "]}\n";
+  }
+
+  void writeBinary(std::ostream& out) const {
+    Writer w(out);
+    w << "MGRF";
+    w.raw(uint32_t{1});
+    w.raw(static_cast<uint32_t>(shown_.size()));
+    w.raw(static_cast<uint32_t>(num_edges_));
+    for (NodeId id : shown_) {
+      const Shown& s = state_[id];
+      const auto& node = tape_.nodes[id];
+      w.raw(id);
+      w.raw(static_cast<uint8_t>(node.op));
+      w.raw(s.flags);
+      w.raw(s.flags & kCollapsed ? double(s.same_as) : double(node.data));
+      w.raw(double(node.grad));
+    }
+    for (NodeId id : shown_) {
+      forEachEdge(id, [&](NodeId child) {
+        w.raw(child);
+        w.raw(id);
+      });
+    }
+  }
+
+ private:
+  struct Shown {
+    bool shown = false;
+    uint8_t flags = 0;
+    int depth = std::numeric_limits<int>::max();
+    NodeId same_as = kNoNode;
+  };
+
+  // Appends to a fixed buffer and writes it out whenever it fills up.
+  class Writer {
+   public:
+    explicit Writer(std::ostream& out) : out_(out) { buf_.reserve(kSize); }
+    ~Writer() { flush(); }
+
+    Writer& operator<<(std::string_view s) {
+      if (buf_.size() + s.size() > kSize) flush();
+      buf_.append(s);
+      return *this;
+    }
+    Writer& operator<<(char c) { return *this << std::string_view(&c, 1); }
+    Writer& operator<<(NodeId v) { return number(v); }
+    Writer& operator<<(double v) { return number(v); }
+
+    // JSON string contents.
+    void escaped(std::string_view s) {
+      for (char c : s) {
+        if (c == '"' || c == '\\') {
+          *this << '\\' << c;
+        } else if (c == '\n') {
+          *this << "\\n";
+        } else {
+          *this << c;
+        }
+      }
+    }
+
+    void jsonNumber(double v) {
+      if (std::isfinite(v)) {
+        *this << v;
+      } else {
+        *this << "null";
+      }
+    }
+
+    // Little-endian bytes of v.
+    template <typename V>
+    void raw(V v) {
+      char bytes[sizeof(V)];
+      std::memcpy(bytes, &v, sizeof(V));
+      if constexpr (std::endian::native == std::endian::big) {
+        std::reverse(bytes, bytes + sizeof(V));
+      }
+      *this << std::string_view(bytes, sizeof(V));
+    }
+
+   private:
+    static constexpr size_t kSize = 1 << 16;
+
+    template <typename V>
+    Writer& number(V v) {
+      char digits[32];
+      const auto result = std::to_chars(digits, digits + sizeof(digits), v);
+      return *this << std::string_view(digits, result.ptr - digits);
+    }
+
+    void flush() {
+      out_.write(buf_.data(), buf_.size());
+      buf_.clear();
+    }
+
+    std::ostream& out_;
+    std::string buf_;
+  };
+
+  static std::string_view opName(ExprOp op) {
+    switch (op) {
+      case ExprOp::Leaf:
+        return "leaf";
+      case ExprOp::Add:
+        return "+";
+      case ExprOp::Mult:
+        return "*";
+      case ExprOp::Tanh:
+        return "tanh";
+    }
+    return "";
+  }
+
+  void writeName(Writer& w, NodeId id) const {
+    if (id < labels_.size() && !labels_[id].empty()) {
+      w.escaped(labels_[id]);
+    } else {
+      w << opName(tape_.nodes[id].op);
+    }
+  }
+
+  // Calls f(operand) for each edge into a shown, expanded node.
+  template <typename F>
+  void forEachEdge(NodeId id, F&& f) const {
+    if (state_[id].flags != 0) return;
+    const auto& node = tape_.nodes[id];
+    for (int i = 0; i < numChildren(node.op); ++i) f(node.children[i]);
+  }
+
+  // Decides which nodes are shown, in decreasing id order. Every result has a
+  // larger id than its operands, so a node's depth (its shortest distance from
+  // the root) and whether any expanded node uses it are settled by the time
+  // it is reached.
+  void select(NodeId root) {
+    const auto& nodes = tape_.nodes;
+    state_.assign(root + 1, Shown{});
+    std::vector<uint32_t> shapes;
+    std::vector<size_t> shape_sizes;
+    if (options_.collapse_min_nodes > 0) {
+      computeShapes(root, shapes, shape_sizes);
+    }
+    absl::flat_hash_map<uint32_t, NodeId> first_with_shape;
+
+    state_[root].shown = true;
+    state_[root].depth = 0;
+    for (NodeId id = root + 1; id-- > 0;) {
+      Shown& s = state_[id];
+      if (!s.shown) continue;
+      shown_.push_back(id);
+      const auto& node = nodes[id];
+      if (node.op == ExprOp::Leaf) continue;
+
+      // Truncate first, so that collapsed nodes only ever refer to an
+      // expanded one.
+      if (options_.max_depth >= 0 && s.depth >= options_.max_depth) {
+        s.flags = kTruncated;
+        continue;
+      }
+      if (options_.collapse_min_nodes > 0 &&
+          shape_sizes[shapes[id]] >= options_.collapse_min_nodes) {
+        const auto [it, inserted] = first_with_shape.emplace(shapes[id], id);
+        if (!inserted) {
+          s.flags = kCollapsed;
+          s.same_as = it->second;
+          continue;
+        }
+      }
+      for (int i = 0; i < numChildren(node.op); ++i) {
+        Shown& child = state_[node.children[i]];
+        child.shown = true;
+        child.depth = std::min(child.depth, s.depth + 1);
+        ++num_edges_;
+      }
+    }
+  }
+
+  // Hash-conses the structure under each reachable node into a small integer,
+  // treating all leaves as equal, and counts the nodes of each structure as a
+  // tree (saturating, since sharing can make that exponential).
+  void computeShapes(NodeId root,
+                     std::vector<uint32_t>& shapes,
+                     std::vector<size_t>& sizes) const {
+    const auto& nodes = tape_.nodes;
+    std::vector<bool> reachable(root + 1);
+    reachable[root] = true;
+    for (NodeId id = root + 1; id-- > 0;) {
+      if (!reachable[id]) continue;
+      for (int i = 0; i < numChildren(nodes[id].op); ++i) {
+        reachable[nodes[id].children[i]] = true;
+      }
+    }
+
+    absl::flat_hash_map<std::tuple<ExprOp, uint32_t, uint32_t>, uint32_t> ids;
+    shapes.assign(root + 1, 0);
+    sizes = {1};  // Shape 0 is any leaf.
+    for (NodeId id = 0; id <= root; ++id) {
+      const auto& node = nodes[id];
+      if (!reachable[id] || node.op == ExprOp::Leaf) continue;
+      const uint32_t a = shapes[node.children[0]];
+      const bool binary = numChildren(node.op) > 1;
+      const uint32_t b = binary ? shapes[node.children[1]] : 0;
+      const auto [it, inserted] =
+          ids.emplace(std::tuple(node.op, a, b), sizes.size());
+      if (inserted) {
+        const size_t size = 1 + sizes[a] + (binary ? sizes[b] : 0);
+        sizes.push_back(std::min(size, kMaxSize));
+      }
+      shapes[id] = it->second;
+    }
+  }
+
+  static constexpr size_t kMaxSize = std::numeric_limits<size_t>::max() / 2;
+
+  const Tape<T>& tape_;
+  std::span<const std::string> labels_;
+  ExportOptions options_;
+  std::vector<Shown> state_;  // Indexed by NodeId, up to the root.
+  std::vector<NodeId> shown_;  // In decreasing id order.
+  size_t num_edges_ = 0;
+};
+
+#endif  // DEEPLEARNING_GRAPH_EXPORT_H_
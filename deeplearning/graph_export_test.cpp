@@ -0,0 +1,181 @@
+#include "graph_export.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include "gmock/gmock.h"
+#include "micrograd.h"
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+namespace {
+
+// The graph from devNewAPI() in gen_dot_graph.cpp.
+ExprTree<double> multiEdgeTree() {
+  ExprTree<double> tree;
+  tree.reg(Value(-2.), "a");
+  tree.reg(Value(3.), "b");
+  tree.reg(tree("a") * tree("b"), "d");
+  tree.reg(tree("a") + tree("b"), "e");
+  tree.reg(tree("d") * tree("e"), "f");
+  tree.runBackprop("f");
+  return tree;
+}
+
+// n identical neurons tanh(x_i * w_i + b_i), summed.
+NodeId neurons(Tape<double>& tape, int n) {
+  NodeId sum = tape.leaf(0);
+  for (int i = 0; i < n; ++i) {
+    const NodeId xw = tape.mul(tape.leaf(i), tape.leaf(0.5));
+    sum = tape.add(sum, tape.tanh(tape.add(xw, tape.leaf(0.1))));
+  }
+  return sum;
+}
+
+template <typename T>
+T read(const std::string& bytes, size_t& pos) {
+  T v;
+  std::memcpy(&v, bytes.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return v;
+}
+
+}  // namespace
+
+TEST(GraphExportTest, Dot) {
+  const ExprTree<double> tree = multiEdgeTree();
+  std::ostringstream out;
+  GraphExporter<double>(tree, "f").writeDot(out);
+  const std::string dot = out.str();
+
+  EXPECT_THAT(dot, HasSubstr("digraph G {"));
+  EXPECT_THAT(dot, HasSubstr("n4 [label=\"f\\ndata -6\\ngrad 1\"];"));
+  EXPECT_THAT(dot, HasSubstr("n0 [label=\"a\\ndata -2\\ngrad -3\"];"));
+  // a and b each feed both d and e.
+  for (const char* edge : {"n2 -> n4;", "n3 -> n4;", "n0 -> n2;", "n1 -> n2;",
+                           "n0 -> n3;", "n1 -> n3;"}) {
+    EXPECT_THAT(dot, HasSubstr(edge));
+  }
+}
+
+TEST(GraphExportTest, Json) {
+  const ExprTree<double> tree = multiEdgeTree();
+  std::ostringstream out;
+  GraphExporter<double>(tree, "e").writeJson(out);
+  EXPECT_EQ(
+      "{\"nodes\":["
+      "{\"id\":3,\"op\":\"+\",\"label\":\"e\",\"data\":1,\"grad\":-6},"
+      "{\"id\":1,\"op\":\"leaf\",\"label\":\"b\",\"data\":3,\"grad\":-8},"
+      "{\"id\":0,\"op\":\"leaf\",\"label\":\"a\",\"data\":-2,\"grad\":-3}],"
+      "\"edges\":[[0,3],[1,3]]}\n",
+      out.str());
+}
+
+TEST(GraphExportTest, BinaryRoundTrip) {
+  const ExprTree<double> tree = multiEdgeTree();
+  GraphExporter<double> exporter(tree, "f");
+  std::ostringstream out;
+  exporter.writeBinary(out);
+  const std::string bytes = out.str();
+
+  ASSERT_EQ("MGRF", bytes.substr(0, 4));
+  size_t pos = 4;
+  EXPECT_EQ(1, read<uint32_t>(bytes, pos));
+  const uint32_t num_nodes = read<uint32_t>(bytes, pos);
+  const uint32_t num_edges = read<uint32_t>(bytes, pos);
+  EXPECT_EQ(5, num_nodes);
+  EXPECT_EQ(6, num_edges);
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    const NodeId id = read<uint32_t>(bytes, pos);
+    EXPECT_EQ(tree.tape.nodes[id].op, ExprOp(read<uint8_t>(bytes, pos)));
+    EXPECT_EQ(0, read<uint8_t>(bytes, pos));
+    EXPECT_EQ(tree.tape.nodes[id].data, read<double>(bytes, pos));
+    EXPECT_EQ(tree.tape.nodes[id].grad, read<double>(bytes, pos));
+  }
+  for (uint32_t i = 0; i < num_edges; ++i) {
+    const NodeId operand = read<uint32_t>(bytes, pos);
+    const NodeId result = read<uint32_t>(bytes, pos);
+    EXPECT_THAT(tree.tape.nodes[result].children, testing::Contains(operand));
+  }
+  EXPECT_EQ(bytes.size(), pos);
+}
+
+TEST(GraphExportTest, MaxDepth) {
+  Tape<double> tape;
+  const NodeId root = neurons(tape, 3);
+  std::ostringstream out;
+  GraphExporter<double> exporter(tape, root, {.max_depth = 1});
+  exporter.writeDot(out);
+  // The root and its two operands, one of which is cut off.
+  EXPECT_EQ(3, exporter.numNodes());
+  EXPECT_EQ(2, exporter.numEdges());
+  EXPECT_THAT(out.str(), HasSubstr("style=dashed"));
+}
+
+TEST(GraphExportTest, CollapseRepeatedSubgraphs) {
+  Tape<double> tape;
+  const NodeId root = neurons(tape, 50);
+  const GraphExporter<double> full(tape, root);
+  const GraphExporter<double> collapsed(tape, root, {.collapse_min_nodes = 4});
+
+  // 1 + 50 * 7 nodes in full, but the neurons beyond the first are single
+  // nodes in the collapsed graph.
+  EXPECT_EQ(tape.size(), full.numNodes());
+  EXPECT_EQ(1 + 50 + 49 + 6, collapsed.numNodes());
+
+  std::ostringstream out;
+  collapsed.writeDot(out);
+  EXPECT_THAT(out.str(), HasSubstr("same as n"));
+  std::ostringstream json;
+  collapsed.writeJson(json);
+  EXPECT_THAT(json.str(), HasSubstr("\"same_as\":"));
+}
+
+TEST(GraphExportTest, CollapsesOnlyIntoExpandedNodes) {
+  // Two copies of the same 6-node subgraph: b is reached first (higher id)
+  // but cut off at max_depth, a is shallower and shown in full.
+  Tape<double> tape;
+  auto subgraph = [&] {
+    return tape.tanh(tape.add(tape.mul(tape.leaf(1), tape.leaf(2)),
+                              tape.leaf(3)));
+  };
+  const NodeId a = subgraph();
+  const NodeId b = subgraph();
+  const NodeId root = tape.add(a, tape.tanh(tape.tanh(tape.tanh(b))));
+  const GraphExporter<double> exporter(
+      tape, root, {.max_depth = 4, .collapse_min_nodes = 4});
+
+  // The root, three tanh, b truncated, and all 6 nodes of a.
+  EXPECT_EQ(11, exporter.numNodes());
+  EXPECT_EQ(10, exporter.numEdges());
+  std::ostringstream json;
+  exporter.writeJson(json);
+  EXPECT_THAT(json.str(), Not(HasSubstr("\"same_as\":")));
+  EXPECT_THAT(json.str(), HasSubstr("\"truncated\":true"));
+}
+
+TEST(GraphExportTest, JsonHasNullForNonFiniteValues) {
+  Tape<double> tape;
+  const NodeId root = tape.add(
+      tape.leaf(std::numeric_limits<double>::quiet_NaN()),
+      tape.leaf(std::numeric_limits<double>::infinity()));
+  std::ostringstream json;
+  GraphExporter<double>(tape, root).writeJson(json);
+  EXPECT_THAT(json.str(), HasSubstr("\"data\":null"));
+  EXPECT_THAT(json.str(), Not(HasSubstr("nan")));
+  EXPECT_THAT(json.str(), Not(HasSubstr("inf")));
+}
+
+TEST(GraphExportTest, EscapesLabels) {
+  ExprTree<double> tree;
+  tree.reg(Value(1.), "say \"hi\"");
+  std::ostringstream out;
+  GraphExporter<double>(tree, "say \"hi\"", {.include_values = false})
+      .writeDot(out);
+  EXPECT_THAT(out.str(), HasSubstr("[label=\"say \\\"hi\\\"\"]"));
+  EXPECT_THAT(out.str(), Not(HasSubstr("data")));
+}
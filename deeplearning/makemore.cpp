@@ -0,0 +1,227 @@
+// Trains the character-level language models from the makemore lectures
+// (https://github.com/karpathy/makemore) on names.txt, without Python.
+//
+// Run in opt mode for accurate throughput, with:
+// bazel run --compilation_mode=opt deeplearning:makemore --
+//     [bigram|mlp] [steps] [names.txt] [threads]
+//
+// Each model is built once as a TensorTape sized for one minibatch shard.
+// Every step samples token indices straight from the memory-mapped file into
+// each shard's input and target buffers, then replays forward and backward in
+// place. With more than one thread, the minibatch is split into one shard per
+// thread (see data_parallel.h).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "absl/random/random.h"
+#include "char_dataset.h"
+#include "data_parallel.h"
+#include "systems/work_stealing_pool.h"
+#include "tensor.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Model {
+  TensorTape<float> tape;
+  std::vector<NodeId> params;
+  NodeId inputs;  // Gather node whose indices are the batch's contexts.
+  NodeId loss;    // CrossEntropy node whose indices are the batch's targets.
+  int block_size;
+};
+
+struct TrainConfig {
+  int batch_size;
+  int steps;
+  float learning_rate;
+  // Learning rate for the second half of training.
+  float final_learning_rate;
+};
+
+Matrix<float> gaussian(absl::BitGen& gen, int rows, int cols, float scale) {
+  Matrix<float> m(rows, cols);
+  for (Eigen::Index i = 0; i < m.size(); ++i) {
+    m.data()[i] = scale * absl::Gaussian<float>(gen);
+  }
+  return m;
+}
+
+// logits = W[previous token]: a learned table of next-token log-counts.
+Model buildBigram(absl::BitGen& gen, int batch_size) {
+  Model model;
+  auto& t = model.tape;
+  model.block_size = 1;
+  const NodeId w = t.leaf(gaussian(
+      gen, CharDataset::kVocabSize, CharDataset::kVocabSize, 1.0f));
+  model.params = {w};
+  model.inputs = t.gather(w, std::vector<int32_t>(batch_size));
+  model.loss = t.crossEntropy(model.inputs, std::vector<int32_t>(batch_size));
+  return model;
+}
+
+// Bengio et al. 2003: embed the previous block_size tokens, concatenate,
+// then one tanh hidden layer and a softmax over the vocabulary.
+Model buildMlp(absl::BitGen& gen, int batch_size) {
+  constexpr int kBlockSize = 3;
+  constexpr int kEmbedding = 10;
+  constexpr int kHidden = 200;
+  const int fan_in = kBlockSize * kEmbedding;
+
+  Model model;
+  auto& t = model.tape;
+  model.block_size = kBlockSize;
+  const NodeId c =
+      t.leaf(gaussian(gen, CharDataset::kVocabSize, kEmbedding, 1.0f));
+  // Kaiming init for tanh, as in the lectures.
+  const NodeId w1 = t.leaf(
+      gaussian(gen, fan_in, kHidden, (5.0f / 3) / std::sqrt(float(fan_in))));
+  const NodeId b1 = t.leaf(gaussian(gen, 1, kHidden, 0.01f));
+  const NodeId w2 =
+      t.leaf(gaussian(gen, kHidden, CharDataset::kVocabSize, 0.01f));
+  const NodeId b2 = t.leaf(Matrix<float>::Zero(1, CharDataset::kVocabSize));
+  model.params = {c, w1, b1, w2, b2};
+
+  model.inputs =
+      t.gather(c, std::vector<int32_t>(batch_size * kBlockSize), kBlockSize);
+  const NodeId h = t.tanh(t.add(t.matmul(model.inputs, w1), b1));
+  const NodeId logits = t.add(t.matmul(h, w2), b2);
+  model.loss = t.crossEntropy(logits, std::vector<int32_t>(batch_size));
+  return model;
+}
+
+void train(DataParallel<Model>& dp,
+           const CharDataset& dataset,
+           const TrainConfig& config,
+           WorkStealingPool& pool) {
+  // One generator per shard, so sampling is reproducible for a given number
+  // of shards however they are scheduled.
+  std::vector<absl::BitGen> shard_gens;
+  for (size_t s = 0; s < dp.numShards(); ++s) {
+    shard_gens.emplace_back(std::seed_seq{2147483647, int(s)});
+  }
+
+  Model& master = dp.master();
+  const int log_every = std::max(1, config.steps / 20);
+  auto window_start = Clock::now();
+  int window_steps = 0;
+
+  for (int step = 0; step < config.steps; ++step) {
+    const float loss = dp.step(pool, [&](size_t s, Model& replica) {
+      dataset.sampleBatch(shard_gens[s],
+                          replica.tape.mutableIndices(replica.inputs),
+                          replica.tape.mutableIndices(replica.loss));
+    });
+
+    const float lr = step < config.steps / 2 ? config.learning_rate
+                                             : config.final_learning_rate;
+    for (size_t i = 0; i < master.params.size(); ++i) {
+      master.tape.mutableValue(master.params[i]) -= lr * dp.grad(i);
+    }
+
+    ++window_steps;
+    if ((step + 1) % log_every == 0 || step + 1 == config.steps) {
+      const std::chrono::duration<double> elapsed =
+          Clock::now() - window_start;
+      std::printf("step %7d  loss %.4f  %.0f tokens/s\n",
+                  step + 1,
+                  loss,
+                  window_steps * config.batch_size / elapsed.count());
+      window_start = Clock::now();
+      window_steps = 0;
+    }
+  }
+}
+
+// Mean loss over every example in the dataset, evaluated in chunks on a copy
+// of the model sized for the chunk.
+float datasetLoss(const Model& trained,
+                  Model eval,
+                  const CharDataset& dataset,
+                  int chunk_size) {
+  auto& t = eval.tape;
+  for (size_t i = 0; i < trained.params.size(); ++i) {
+    t.mutableValue(eval.params[i]) = trained.tape.value(trained.params[i]);
+  }
+
+  // Only replay up to the logits, since the last chunk is partial and the
+  // loss is accumulated over just the rows that hold real examples.
+  const NodeId logits = t.nodes[eval.loss].children[0];
+  auto& contexts = t.mutableIndices(eval.inputs);
+  const size_t n = dataset.numExamples();
+  double total = 0;
+  for (size_t begin = 0; begin < n; begin += chunk_size) {
+    const size_t count = std::min<size_t>(chunk_size, n - begin);
+    std::vector<int32_t> targets(count);
+    for (size_t b = 0; b < count; ++b) {
+      targets[b] = dataset.example(
+          begin + b,
+          std::span(contexts).subspan(b * eval.block_size, eval.block_size));
+    }
+    t.forward(logits);
+    for (size_t b = 0; b < count; ++b) {
+      const auto row = t.value(logits).row(b).array();
+      const float max = row.maxCoeff();
+      total += max + std::log((row - max).exp().sum()) - row(targets[b]);
+    }
+  }
+  return total / n;
+}
+
+int main(int argc, char** argv) {
+  const std::string model_name = argc > 1 ? argv[1] : "mlp";
+  const std::string path =
+      argc > 3 ? argv[3] : "deeplearning/tutorials/data/names.txt";
+
+  TrainConfig config;
+  Model (*build)(absl::BitGen&, int);
+  if (model_name == "bigram") {
+    build = buildBigram;
+    config = {.batch_size = 512,
+              .steps = 2000,
+              .learning_rate = 10.0f,
+              .final_learning_rate = 1.0f};
+  } else if (model_name == "mlp") {
+    build = buildMlp;
+    config = {.batch_size = 32,
+              .steps = 200000,
+              .learning_rate = 0.1f,
+              .final_learning_rate = 0.01f};
+  } else {
+    std::fprintf(
+        stderr,
+        "Usage: %s [bigram|mlp] [steps] [names.txt] [threads]\n",
+        argv[0]);
+    return 1;
+  }
+  if (argc > 2) config.steps = std::atoi(argv[2]);
+  const int num_threads = argc > 4 ? std::max(1, std::atoi(argv[4])) : 1;
+  // Round the batch up to whole shards.
+  const int shard_batch = (config.batch_size + num_threads - 1) / num_threads;
+  config.batch_size = shard_batch * num_threads;
+
+  const CharDataset dataset(path);
+  std::printf("%s: %zu examples, %d steps of batch %d on %d threads\n",
+              model_name.c_str(),
+              dataset.numExamples(),
+              config.steps,
+              config.batch_size,
+              num_threads);
+
+  absl::BitGen gen(std::seed_seq{2147483647});
+  DataParallel<Model> dp([&] { return build(gen, shard_batch); }, num_threads);
+  WorkStealingPool pool(num_threads);
+  train(dp, dataset, config, pool);
+
+  constexpr int kEvalChunk = 4096;
+  std::printf(
+      "dataset loss %.4f\n",
+      datasetLoss(dp.master(), build(gen, kEvalChunk), dataset, kEvalChunk));
+  return 0;
+}
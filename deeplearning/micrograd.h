@@ -5,13 +5,212 @@
 // "The spelled-out intro to neural networks and backpropagation: building
 // micrograd" -- https://www.youtube.com/watch?v=VMj-3S1tku0
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
-#include <type_traits>
-#include <unordered_set>
+#include <vector>
 
-enum class ExprOp { Add, Mult, Tanh };
+#include "absl/container/flat_hash_map.h"
 
+enum class ExprOp { Leaf, Add, Mult, Tanh };
+
+inline int numChildren(ExprOp op) {
+  switch (op) {
+    case ExprOp::Leaf:
+      return 0;
+    case ExprOp::Tanh:
+      return 1;
+    default:
+      return 2;
+  }
+}
+
+// tanh of a node's data. Unqualified, so that scalar types other than float
+// and double (such as Dual in dual.h) can provide their own overload.
+template <typename T>
+T tanhOf(const T& x) {
+  using std::tanh;
+  return tanh(x);
+}
+
+// Handle to a node on a Tape: its index in the tape's arena.
+using NodeId = uint32_t;
+inline constexpr NodeId kNoNode = ~NodeId{0};
+
+template <typename T>
+struct TapeNode {
+  T data;
+  T grad;
+  ExprOp op;
+  // Operands, of which only the first numChildren(op) are set.
+  std::array<NodeId, 2> children;
+};
+
+// The expression graph as a flat arena of nodes. Operands must already be on
+// the tape, so every node is appended after its children.
+template <typename T>
+class Tape {
+ public:
+  NodeId leaf(T val) { return push(val, ExprOp::Leaf, {kNoNode, kNoNode}); }
+
+  NodeId add(NodeId a, NodeId b) {
+    return push(nodes[a].data + nodes[b].data, ExprOp::Add, {a, b});
+  }
+
+  NodeId mul(NodeId a, NodeId b) {
+    return push(nodes[a].data * nodes[b].data, ExprOp::Mult, {a, b});
+  }
+
+  NodeId tanh(NodeId a) {
+    return push(tanhOf(nodes[a].data), ExprOp::Tanh, {a, kNoNode});
+  }
+
+  NodeId push(T data, ExprOp op, std::array<NodeId, 2> children) {
+    nodes.push_back({data, T{0}, op, children});
+    return static_cast<NodeId>(nodes.size() - 1);
+  }
+
+  size_t size() const { return nodes.size(); }
+
+  // Recomputes the data of every node that `root` depends on, in tape order.
+  // Leaves keep whatever data they were last assigned, so a step can update
+  // its inputs in place and replay the graph without rebuilding it.
+  void forward(NodeId root) {
+    for (NodeId id : topologicalOrder(root)) {
+      auto& node = nodes[id];
+      const auto& c = node.children;
+      switch (node.op) {
+        case ExprOp::Leaf:
+          break;
+        case ExprOp::Add:
+          node.data = nodes[c[0]].data + nodes[c[1]].data;
+          break;
+        case ExprOp::Mult:
+          node.data = nodes[c[0]].data * nodes[c[1]].data;
+          break;
+        case ExprOp::Tanh:
+          node.data = tanhOf(nodes[c[0]].data);
+          break;
+      }
+    }
+  }
+
+  // Reverse-mode sweep over the nodes that `root` depends on. Each node's
+  // gradient is complete before it is pushed to its operands, so every edge is
+  // visited once: O(nodes + edges), with no recursion.
+  void backward(NodeId root) {
+    const auto& order = topologicalOrder(root);
+    nodes[root].grad = 1.0;
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+      const auto& node = nodes[*it];
+      const auto& c = node.children;
+      switch (node.op) {
+        case ExprOp::Leaf:
+          break;
+        case ExprOp::Add:
+          nodes[c[0]].grad += node.grad;
+          nodes[c[1]].grad += node.grad;
+          break;
+        case ExprOp::Mult:
+          nodes[c[0]].grad += node.grad * nodes[c[1]].data;
+          nodes[c[1]].grad += node.grad * nodes[c[0]].data;
+          break;
+        case ExprOp::Tanh:
+          nodes[c[0]].grad += node.grad * (1 - node.data * node.data);
+          break;
+      }
+    }
+  }
+
+  // Reference implementation that pushes gradients down every path from the
+  // root separately. Its cost grows with the number of paths, which is
+  // exponential in depth for graphs with reuse, so it is only kept for tests
+  // and benchmarks.
+  void backwardByPaths(NodeId root) {
+    nodes[root].grad = 1.0;
+    backwardRecursive(root, nodes[root].grad);
+  }
+
+  void zeroGrad() {
+    for (auto& node : nodes) node.grad = 0;
+  }
+
+  // Ends a training step: drops every node from `n` on (typically everything
+  // built after the parameters) and zeroes the grads of the nodes that are
+  // left. Nodes are trivially destructible, so dropping them is O(1) and the
+  // arena keeps its capacity for the next step's graph.
+  void truncate(size_t n) {
+    nodes.resize(std::min(n, nodes.size()));
+    zeroGrad();
+    // The next graph may reuse the root id at the same tape size.
+    order_root_ = kNoNode;
+  }
+
+  // The nodes that `root` depends on (including itself) in increasing id
+  // order, which is a topological order because operands always precede
+  // their results on the tape. Cached until the tape grows or the root
+  // changes, so repeated forward/backward steps over the same graph don't
+  // recompute it.
+  const std::vector<NodeId>& topologicalOrder(NodeId root) {
+    if (root == order_root_ && nodes.size() == order_tape_size_) {
+      return order_;
+    }
+
+    // A single downward scan from the root marks everything reachable, since
+    // each node's operands have smaller ids than the node itself.
+    std::vector<bool> reachable(root + 1);
+    reachable[root] = true;
+    size_t num_reachable = 0;
+    for (NodeId id = root + 1; id-- > 0;) {
+      if (!reachable[id]) continue;
+      ++num_reachable;
+      const auto& node = nodes[id];
+      for (int i = 0; i < numChildren(node.op); ++i) {
+        reachable[node.children[i]] = true;
+      }
+    }
+
+    order_.clear();
+    order_.reserve(num_reachable);
+    for (NodeId id = 0; id <= root; ++id) {
+      if (reachable[id]) order_.push_back(id);
+    }
+    order_root_ = root;
+    order_tape_size_ = nodes.size();
+    return order_;
+  }
+
+  std::vector<TapeNode<T>> nodes;
+
+ private:
+  // Pushes the gradient flowing into `id` along one path down to its children.
+  void backwardRecursive(NodeId id, T upstream) {
+    const TapeNode<T> node = nodes[id];
+    if (node.op == ExprOp::Leaf) return;
+    for (int i = 0; i < numChildren(node.op); ++i) {
+      const NodeId child = node.children[i];
+      T local = 1;
+      if (node.op == ExprOp::Mult) {
+        local = nodes[node.children[1 - i]].data;
+      } else if (node.op == ExprOp::Tanh) {
+        local = 1 - node.data * node.data;
+      }
+      nodes[child].grad += upstream * local;
+      backwardRecursive(child, upstream * local);
+    }
+  }
+
+  std::vector<NodeId> order_;
+  NodeId order_root_ = kNoNode;
+  size_t order_tape_size_ = 0;
+};
+
+// A node's value, operation and operands. Values returned by ExprTree are
+// snapshots of a tape node, and combining them yields a new (not yet
+// registered) node that refers to its operands by NodeId.
 template <typename T>
 class Value {
  public:
@@ -19,76 +218,85 @@ class Value {
   // result of an operation).
   Value(T val) : data(val) {}
 
-  Value(T val, std::unordered_set<std::string> prev, ExprOp op)
+  Value(T val, std::array<NodeId, 2> prev, ExprOp op)
       : data(val), children(prev), op(op) {}
 
   Value operator+(const Value<T>& other) const {
-    return Value(data + other.data, {label, other.label}, ExprOp::Add);
+    return Value(data + other.data, {id, other.id}, ExprOp::Add);
   }
 
   Value operator*(const Value<T>& other) const {
-    return Value(data * other.data, {label, other.label}, ExprOp::Mult);
+    return Value(data * other.data, {id, other.id}, ExprOp::Mult);
   }
 
-  Value tanh() const { return Value(std::tanh(data), {label}, ExprOp::Tanh); }
+  Value tanh() const {
+    return Value(tanhOf(data), {id, kNoNode}, ExprOp::Tanh);
+  }
 
   bool operator==(const Value<T>& other) const {
-    return data == other.data && label == other.label;
+    return data == other.data && id == other.id;
   }
   bool operator==(const Value<T>* other) const {
-    return data == other->data && label == other->label;
+    return data == other->data && id == other->id;
   }
 
   T data;
-  std::unordered_set<std::string> children;
-  std::string label;
-  ExprOp op;
-  double grad = 0.;
+  std::array<NodeId, 2> children = {kNoNode, kNoNode};
+  ExprOp op = ExprOp::Leaf;
+  T grad = 0;
+  NodeId id = kNoNode;  // Set once the value is registered on a tape.
 };
 
+// Label-based API on top of a Tape. Labels are only used to look up nodes; the
+// tape itself and backprop work purely with integer handles.
 template <typename T>
 class ExprTree {
  public:
-  const Value<T>& operator()(const std::string& label) const {
+  Value<T> operator()(const std::string& label) const {
     // Throws if label doesn't exist. Just to keep the API compact.
-    return nodes.at(label);
+    return (*this)(ids.at(label));
   }
 
-  void reg(Value<T> expr, const std::string& label) {
-    expr.label = label;
-    nodes.emplace(label, std::move(expr));
+  Value<T> operator()(NodeId id) const {
+    const auto& node = tape.nodes.at(id);
+    Value<T> v(node.data, node.children, node.op);
+    v.grad = node.grad;
+    v.id = id;
+    return v;
   }
 
-  void runBackpropRecursive(Value<T>& curr_node, const Value<T>& parent) {
-    curr_node.grad += parent.grad;
-    if (parent.op == ExprOp::Mult) {
-      for (const auto& sib_label : parent.children) {
-        auto& sib = nodes.at(sib_label);
-        if (sib.label != curr_node.label) {
-          curr_node.grad *= sib.data;
-        }
+  void reg(const Value<T>& expr, const std::string& label) {
+    for (int i = 0; i < numChildren(expr.op); ++i) {
+      if (expr.children[i] >= tape.size()) {
+        throw std::out_of_range("Operand of " + label + " is not registered");
       }
-    } else if (parent.op == ExprOp::Add) {
-      // Nothing. The partial deriv is 1.
-    } else if (parent.op == ExprOp::Tanh) {
-      curr_node.grad *= 1 - std::pow(parent.data, 2);
-    }
-    for (const auto& child_label : curr_node.children) {
-      auto& child_node = nodes.at(child_label);
-      this->runBackpropRecursive(child_node, curr_node);
     }
+    const NodeId id = tape.push(expr.data, expr.op, expr.children);
+    labels.push_back(label);
+    ids.insert_or_assign(label, id);
   }
 
   void runBackprop(const std::string& root_label) {
-    auto& root = nodes.at(root_label);
-    root.grad = 1.0;
-    for (const auto& child_label : root.children) {
-      auto& child_node = nodes.at(child_label);
-      runBackpropRecursive(child_node, root);
+    tape.backward(ids.at(root_label));
+  }
+
+  size_t size() const { return tape.size(); }
+
+  // Tape::truncate, also forgetting the labels of the dropped nodes. This is
+  // linear in the number of dropped labels, which are hashed. A label that
+  // was re-registered after node `n` is forgotten altogether.
+  void truncate(size_t n) {
+    for (size_t id = n; id < labels.size(); ++id) {
+      const auto it = ids.find(labels[id]);
+      if (it != ids.end() && it->second >= n) ids.erase(it);
     }
+    labels.resize(std::min(n, labels.size()));
+    tape.truncate(n);
   }
 
-  std::unordered_map<std::string, Value<T>> nodes;
+  Tape<T> tape;
+  std::vector<std::string> labels;  // Indexed by NodeId.
+  absl::flat_hash_map<std::string, NodeId> ids;
 };
 
 #endif  // DEEPLEARNING_MICROGRAD_H_
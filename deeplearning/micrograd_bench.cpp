@@ -0,0 +1,720 @@
+// Run in opt mode for accurate timings, with:
+// bazel run --compilation_mode=opt deeplearning:micrograd_bench
+//
+// Step benchmarks report nodes/s (graph nodes built or visited per second)
+// and, like every benchmark here, allocs (heap allocations per iteration)
+// and hardware counters from systems/instrumentation.h, as a baseline for
+// autograd performance work.
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "compiled_graph.h"
+#include "data_parallel.h"
+#include "dual.h"
+#include "graph_export.h"
+#include "micrograd.h"
+#include "static_expr.h"
+#include "systems/instrumentation.h"
+#include "systems/work_stealing_pool.h"
+#include "tensor.h"
+
+// Sets the nodes/s counter, given the number of graph nodes per iteration.
+void setStepCounters(benchmark::State& state, double nodes_per_step) {
+  state.counters["nodes/s"] = benchmark::Counter(
+      state.iterations() * nodes_per_step, benchmark::Counter::kIsRate);
+}
+
+// A single neuron with n inputs: o = tanh(sum_i x_i * w_i + b), accumulated as
+// a chain of additions.
+struct NeuronLabels {
+  explicit NeuronLabels(int n) {
+    for (int i = 0; i < n; ++i) {
+      x.push_back(absl::StrCat("x", i));
+      w.push_back(absl::StrCat("w", i));
+      xw.push_back(absl::StrCat("x", i, "w", i));
+      sum.push_back(absl::StrCat("sum", i));
+    }
+  }
+
+  std::vector<std::string> x, w, xw, sum;
+};
+
+// Leaves, products, partial sums, bias and tanh.
+int neuronNodeCount(int n) { return 4 * n + 2; }
+
+static void BM_ExprTree_Neuron(benchmark::State& state) {
+  const int n = state.range(0);
+  const NeuronLabels labels(n);
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    ExprTree<double> tree;
+    tree.reg(Value(0.1), "b");
+    std::string prev = "b";
+    for (int i = 0; i < n; ++i) {
+      tree.reg(Value(0.5), labels.x[i]);
+      tree.reg(Value(-0.25), labels.w[i]);
+      tree.reg(tree(labels.x[i]) * tree(labels.w[i]), labels.xw[i]);
+      tree.reg(tree(prev) + tree(labels.xw[i]), labels.sum[i]);
+      prev = labels.sum[i];
+    }
+    tree.reg(tree(prev).tanh(), "o");
+    tree.runBackprop("o");
+    benchmark::DoNotOptimize(tree("b").grad);
+  }
+  counters.stop();
+  setStepCounters(state, neuronNodeCount(n));
+}
+BENCHMARK(BM_ExprTree_Neuron)->RangeMultiplier(4)->Range(4, 1024);
+
+// Graph shapes for ExprTree, registered under the labels "n0", "n1", ... in
+// order. Each returns the label of its root.
+class LabeledGraph {
+ public:
+  explicit LabeledGraph(int max_nodes) {
+    for (int i = 0; i < max_nodes; ++i) names_.push_back(absl::StrCat("n", i));
+  }
+
+  // y <- tanh(y * w_i), n times: a chain of 3 nodes per link.
+  const std::string& chain(ExprTree<double>& tree, int n) {
+    next_ = 0;
+    const std::string* y = &leaf(tree, 0.5);
+    for (int i = 0; i < n; ++i) {
+      const std::string& w = leaf(tree, 0.9);
+      y = &reg(tree, tree(reg(tree, tree(*y) * tree(w))).tanh());
+    }
+    return *y;
+  }
+
+  // Pairwise sum of n leaves: one root depending on every leaf.
+  const std::string& fanIn(ExprTree<double>& tree, int n) {
+    next_ = 0;
+    std::vector<const std::string*> level;
+    for (int i = 0; i < n; ++i) level.push_back(&leaf(tree, 0.01 * i));
+    while (level.size() > 1) {
+      std::vector<const std::string*> next;
+      for (size_t i = 0; i + 1 < level.size(); i += 2) {
+        next.push_back(&reg(tree, tree(*level[i]) + tree(*level[i + 1])));
+      }
+      if (level.size() % 2 == 1) next.push_back(level.back());
+      level = std::move(next);
+    }
+    return *level[0];
+  }
+
+  // A ladder of n rungs where every node is used by the next two, so shared
+  // subexpressions double the number of root-to-leaf paths at each rung.
+  const std::string& sharedDag(ExprTree<double>& tree, int n) {
+    next_ = 0;
+    const std::string* a = &leaf(tree, 0.3);
+    const std::string* b = &leaf(tree, -0.7);
+    for (int i = 0; i < n; ++i) {
+      const std::string& sum = reg(tree, tree(*a) + tree(*b));
+      const std::string& next_a = reg(tree, tree(sum).tanh());
+      b = &reg(tree, tree(*a) * tree(*b));
+      a = &next_a;
+    }
+    return reg(tree, tree(*a) + tree(*b));
+  }
+
+  // The MLP of buildMlp below, through labels.
+  const std::string& mlp(ExprTree<double>& tree, int width, int depth) {
+    next_ = 0;
+    std::vector<const std::string*> layer;
+    for (int i = 0; i < width; ++i) layer.push_back(&leaf(tree, 0.1 * i));
+    for (int d = 0; d < depth; ++d) {
+      std::vector<const std::string*> next;
+      for (int j = 0; j < width; ++j) {
+        const std::string* sum = &leaf(tree, 0.01 * j);
+        for (const std::string* x : layer) {
+          const std::string& w = leaf(tree, 0.5 / width);
+          const std::string& xw = reg(tree, tree(*x) * tree(w));
+          sum = &reg(tree, tree(*sum) + tree(xw));
+        }
+        next.push_back(&reg(tree, tree(*sum).tanh()));
+      }
+      layer = std::move(next);
+    }
+    const std::string* out = layer[0];
+    for (int i = 1; i < width; ++i) {
+      out = &reg(tree, tree(*out) + tree(*layer[i]));
+    }
+    return *out;
+  }
+
+ private:
+  const std::string& leaf(ExprTree<double>& tree, double data) {
+    return reg(tree, Value(data));
+  }
+
+  const std::string& reg(ExprTree<double>& tree, const Value<double>& v) {
+    tree.reg(v, names_[next_]);
+    return names_[next_++];
+  }
+
+  std::vector<std::string> names_;
+  int next_ = 0;
+};
+
+int chainNodeCount(int n) { return 3 * n + 1; }
+int mlpNodeCount(int width, int depth) {
+  return width + depth * width * (3 * width + 2) + width - 1;
+}
+
+// Registering a chain, without backprop.
+static void BM_ExprTree_BuildChain(benchmark::State& state) {
+  const int n = state.range(0);
+  LabeledGraph graph(chainNodeCount(n));
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    ExprTree<double> tree;
+    benchmark::DoNotOptimize(&graph.chain(tree, n));
+  }
+  counters.stop();
+  setStepCounters(state, chainNodeCount(n));
+}
+BENCHMARK(BM_ExprTree_BuildChain)->RangeMultiplier(8)->Range(8, 4096);
+
+// runBackprop over an already registered graph.
+template <typename Build>
+void runBackpropBenchmark(benchmark::State& state, int max_nodes, Build build) {
+  LabeledGraph graph(max_nodes);
+  ExprTree<double> tree;
+  const std::string root = build(graph, tree);
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    tree.tape.zeroGrad();
+    tree.runBackprop(root);
+    benchmark::DoNotOptimize(tree.tape.nodes[0].grad);
+  }
+  counters.stop();
+  setStepCounters(state, tree.size());
+}
+
+static void BM_ExprTree_BackpropChain(benchmark::State& state) {
+  const int n = state.range(0);
+  runBackpropBenchmark(
+      state, chainNodeCount(n), [&](LabeledGraph& graph, auto& tree) {
+        return graph.chain(tree, n);
+      });
+}
+BENCHMARK(BM_ExprTree_BackpropChain)->RangeMultiplier(8)->Range(8, 4096);
+
+static void BM_ExprTree_BackpropFanIn(benchmark::State& state) {
+  const int n = state.range(0);
+  runBackpropBenchmark(state, 2 * n, [&](LabeledGraph& graph, auto& tree) {
+    return graph.fanIn(tree, n);
+  });
+}
+BENCHMARK(BM_ExprTree_BackpropFanIn)->RangeMultiplier(8)->Range(8, 4096);
+
+static void BM_ExprTree_BackpropSharedDag(benchmark::State& state) {
+  const int n = state.range(0);
+  runBackpropBenchmark(state, 3 * n + 3, [&](LabeledGraph& graph, auto& tree) {
+    return graph.sharedDag(tree, n);
+  });
+}
+BENCHMARK(BM_ExprTree_BackpropSharedDag)->RangeMultiplier(8)->Range(8, 4096);
+
+// A full ExprTree training step on MLP-shaped graphs: register every node by
+// label, then runBackprop.
+static void BM_ExprTree_MLP_Step(benchmark::State& state) {
+  const int width = state.range(0), depth = state.range(1);
+  LabeledGraph graph(mlpNodeCount(width, depth));
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    ExprTree<double> tree;
+    tree.runBackprop(graph.mlp(tree, width, depth));
+    benchmark::DoNotOptimize(tree.tape.nodes[0].grad);
+  }
+  counters.stop();
+  setStepCounters(state, mlpNodeCount(width, depth));
+}
+BENCHMARK(BM_ExprTree_MLP_Step)
+    ->ArgsProduct({{4, 16, 64}, {2, 4, 8}})
+    ->ArgNames({"width", "depth"});
+
+static void BM_Tape_Neuron(benchmark::State& state) {
+  const int n = state.range(0);
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    Tape<double> tape;
+    const NodeId b = tape.leaf(0.1);
+    NodeId prev = b;
+    for (int i = 0; i < n; ++i) {
+      const NodeId x = tape.leaf(0.5);
+      const NodeId w = tape.leaf(-0.25);
+      prev = tape.add(prev, tape.mul(x, w));
+    }
+    tape.backward(tape.tanh(prev));
+    benchmark::DoNotOptimize(tape.nodes[b].grad);
+  }
+  counters.stop();
+  setStepCounters(state, neuronNodeCount(n));
+}
+BENCHMARK(BM_Tape_Neuron)->RangeMultiplier(4)->Range(4, 1024);
+
+// A fully connected tanh MLP with `depth` layers of `width` neurons, summed
+// into a single output. Every activation feeds every neuron of the next layer,
+// so the number of root-to-leaf paths grows as width^depth.
+NodeId buildMlp(Tape<double>& tape, int width, int depth) {
+  std::vector<NodeId> layer;
+  for (int i = 0; i < width; ++i) layer.push_back(tape.leaf(0.1 * i));
+  for (int d = 0; d < depth; ++d) {
+    std::vector<NodeId> next;
+    for (int j = 0; j < width; ++j) {
+      NodeId sum = tape.leaf(0.01 * j);
+      for (NodeId x : layer) {
+        sum = tape.add(sum, tape.mul(x, tape.leaf(0.5 / width)));
+      }
+      next.push_back(tape.tanh(sum));
+    }
+    layer = std::move(next);
+  }
+  NodeId out = layer[0];
+  for (int i = 1; i < width; ++i) out = tape.add(out, layer[i]);
+  return out;
+}
+
+static void BM_Tape_MLP_Backward(benchmark::State& state) {
+  Tape<double> tape;
+  const NodeId root = buildMlp(tape, state.range(0), state.range(1));
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    tape.zeroGrad();
+    tape.backward(root);
+    benchmark::DoNotOptimize(tape.nodes[0].grad);
+  }
+  counters.stop();
+  setStepCounters(state, tape.size());
+}
+BENCHMARK(BM_Tape_MLP_Backward)
+    ->ArgsProduct({{4, 16, 64}, {2, 4, 8, 16}})
+    ->ArgNames({"width", "depth"});
+
+// Same graphs, backpropagated separately along every path. Only small depths,
+// since the cost is exponential.
+static void BM_Tape_MLP_BackwardByPaths(benchmark::State& state) {
+  Tape<double> tape;
+  const NodeId root = buildMlp(tape, state.range(0), state.range(1));
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    tape.zeroGrad();
+    tape.backwardByPaths(root);
+    benchmark::DoNotOptimize(tape.nodes[0].grad);
+  }
+  counters.stop();
+  setStepCounters(state, tape.size());
+}
+BENCHMARK(BM_Tape_MLP_BackwardByPaths)
+    ->ArgsProduct({{4}, {2, 4, 6}})
+    ->ArgNames({"width", "depth"});
+
+// A full training step on a fixed graph: replay forward, then backward with
+// the cached topological order.
+static void BM_Tape_MLP_Step(benchmark::State& state) {
+  Tape<double> tape;
+  const NodeId root = buildMlp(tape, state.range(0), state.range(1));
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    tape.forward(root);
+    tape.zeroGrad();
+    tape.backward(root);
+    benchmark::DoNotOptimize(tape.nodes[0].grad);
+  }
+  counters.stop();
+  setStepCounters(state, tape.size());
+}
+BENCHMARK(BM_Tape_MLP_Step)
+    ->ArgsProduct({{16, 64}, {4, 16}})
+    ->ArgNames({"width", "depth"});
+
+// Exporting an MLP graph of range(0) x range(0) neurons (about 3 * 64^3 = 800k
+// nodes at width 64) to a stream that discards its output.
+class NullBuffer : public std::streambuf {
+ protected:
+  std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+  int overflow(int c) override { return c; }
+};
+
+template <typename Write>
+void exportBenchmark(benchmark::State& state, Write write) {
+  Tape<double> tape;
+  const NodeId root = buildMlp(tape, state.range(0), state.range(0));
+  tape.backward(root);
+  NullBuffer null;
+  std::ostream out(&null);
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    GraphExporter<double> exporter(tape, root);
+    write(exporter, out);
+  }
+  counters.stop();
+  state.counters["nodes/s"] = benchmark::Counter(
+      state.iterations() * tape.size(), benchmark::Counter::kIsRate);
+}
+
+static void BM_ExportDot(benchmark::State& state) {
+  exportBenchmark(state, [](const auto& e, auto& out) { e.writeDot(out); });
+}
+BENCHMARK(BM_ExportDot)->Arg(16)->Arg(64)->Unit(benchmark::kMillisecond);
+
+static void BM_ExportJson(benchmark::State& state) {
+  exportBenchmark(state, [](const auto& e, auto& out) { e.writeJson(out); });
+}
+BENCHMARK(BM_ExportJson)->Arg(16)->Arg(64)->Unit(benchmark::kMillisecond);
+
+static void BM_ExportBinary(benchmark::State& state) {
+  exportBenchmark(state,
+                  [](const auto& e, auto& out) { e.writeBinary(out); });
+}
+BENCHMARK(BM_ExportBinary)->Arg(16)->Arg(64)->Unit(benchmark::kMillisecond);
+
+// The neuron of BM_ExprTree_Neuron, captured once and compiled. Each step
+// only writes new inputs and replays forward and backward, so this measures
+// steady-state step latency against rebuilding the graph every step.
+static void BM_Compiled_Neuron(benchmark::State& state) {
+  const int n = state.range(0);
+  Tape<double> tape;
+  NodeId prev = tape.leaf(0.1);
+  std::vector<NodeId> x;
+  for (int i = 0; i < n; ++i) {
+    x.push_back(tape.leaf(0.5));
+    prev = tape.add(prev, tape.mul(x.back(), tape.leaf(-0.25)));
+  }
+  CompiledGraph<double> compiled(tape, tape.tanh(prev));
+  double input = 0;
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    input += 1e-9;
+    for (NodeId id : x) compiled.data(id) = input;
+    compiled.forward();
+    compiled.backward();
+    benchmark::DoNotOptimize(compiled.grad(0));
+  }
+  counters.stop();
+  setStepCounters(state, neuronNodeCount(n));
+}
+BENCHMARK(BM_Compiled_Neuron)->RangeMultiplier(4)->Range(4, 1024);
+
+// The same neuron as a compile-time expression over inputs {b, x0, w0, x1,
+// w1, ...}, for comparison with the runtime graphs at equal n.
+template <size_t... I>
+auto staticNeuron(std::index_sequence<I...>) {
+  return ((StaticVar<double, 2 * I + 1>{} * StaticVar<double, 2 * I + 2>{}) +
+          ... + StaticVar<double, 0>{})
+      .tanh();
+}
+
+template <size_t N>
+static void BM_Static_Neuron(benchmark::State& state) {
+  auto o = staticNeuron(std::make_index_sequence<N>{});
+  std::array<double, 2 * N + 1> inputs, grads;
+  inputs.fill(0.5);
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    inputs[1] += 1e-9;
+    o.forward(inputs);
+    o.backward(grads);
+    benchmark::DoNotOptimize(grads);
+  }
+  counters.stop();
+  setStepCounters(state, neuronNodeCount(N));
+}
+BENCHMARK_TEMPLATE(BM_Static_Neuron, 4);
+BENCHMARK_TEMPLATE(BM_Static_Neuron, 16);
+BENCHMARK_TEMPLATE(BM_Static_Neuron, 64);
+
+static void BM_Compiled_MLP_Step(benchmark::State& state) {
+  Tape<double> tape;
+  const NodeId root = buildMlp(tape, state.range(0), state.range(1));
+  CompiledGraph<double> compiled(tape, root);
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    compiled.forward();
+    compiled.backward();
+    benchmark::DoNotOptimize(compiled.grad(0));
+  }
+  counters.stop();
+  setStepCounters(state, tape.size());
+  state.counters["instructions"] = compiled.program.size();
+}
+BENCHMARK(BM_Compiled_MLP_Step)
+    ->ArgsProduct({{16, 64}, {4, 16}})
+    ->ArgNames({"width", "depth"});
+
+// Full Jacobian of y = tanh(W x + b) for a layer with a few inputs and
+// range(0) outputs: one forward-mode pass per input, versus building the
+// graph once and running one reverse sweep per output.
+constexpr int kJacobianInputs = 4;
+
+template <typename S>
+void tanhLayer(const std::vector<double>& w,
+               const std::vector<S>& x,
+               std::vector<S>& y) {
+  for (size_t j = 0; j < y.size(); ++j) {
+    S acc = 0.1;
+    for (int k = 0; k < kJacobianInputs; ++k) {
+      acc = acc + x[k] * w[j * kJacobianInputs + k];
+    }
+    y[j] = tanhOf(acc);
+  }
+}
+
+std::vector<double> layerWeights(int outputs) {
+  std::vector<double> w(outputs * kJacobianInputs);
+  for (size_t i = 0; i < w.size(); ++i) w[i] = std::sin(i + 1.0);
+  return w;
+}
+
+static void BM_Forward_LayerJacobian(benchmark::State& state) {
+  const int m = state.range(0);
+  const std::vector<double> w = layerWeights(m);
+  std::vector<Dual<double>> x(kJacobianInputs), y(m);
+  std::vector<double> jacobian(m * kJacobianInputs);
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    for (int i = 0; i < kJacobianInputs; ++i) {
+      for (int k = 0; k < kJacobianInputs; ++k) x[k] = {0.5, k == i ? 1. : 0.};
+      tanhLayer(w, x, y);
+      for (int j = 0; j < m; ++j) {
+        jacobian[j * kJacobianInputs + i] = y[j].tangent;
+      }
+    }
+    benchmark::DoNotOptimize(jacobian.data());
+  }
+  counters.stop();
+}
+BENCHMARK(BM_Forward_LayerJacobian)->RangeMultiplier(4)->Range(16, 1024);
+
+static void BM_Reverse_LayerJacobian(benchmark::State& state) {
+  const int m = state.range(0);
+  const std::vector<double> w = layerWeights(m);
+  Tape<double> tape;
+  std::vector<NodeId> x, y(m);
+  for (int k = 0; k < kJacobianInputs; ++k) x.push_back(tape.leaf(0.5));
+  for (int j = 0; j < m; ++j) {
+    NodeId acc = tape.leaf(0.1);
+    for (int k = 0; k < kJacobianInputs; ++k) {
+      acc = tape.add(acc,
+                     tape.mul(x[k], tape.leaf(w[j * kJacobianInputs + k])));
+    }
+    y[j] = tape.tanh(acc);
+  }
+  std::vector<double> jacobian(m * kJacobianInputs);
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    for (int j = 0; j < m; ++j) {
+      tape.zeroGrad();
+      tape.backward(y[j]);
+      for (int k = 0; k < kJacobianInputs; ++k) {
+        jacobian[j * kJacobianInputs + k] = tape.nodes[x[k]].grad;
+      }
+    }
+    benchmark::DoNotOptimize(jacobian.data());
+  }
+  counters.stop();
+}
+BENCHMARK(BM_Reverse_LayerJacobian)->RangeMultiplier(4)->Range(16, 1024);
+
+// One training step (forward, zero grads, backward) of loss = sum(tanh(x w +
+// b)) for a dense layer with 64 inputs and range(0) neurons, as one scalar
+// node per multiply-add versus a handful of tensor nodes.
+constexpr int kLayerInputs = 64;
+
+static void BM_Scalar_DenseLayerStep(benchmark::State& state) {
+  const int n = state.range(0);
+  Tape<double> tape;
+  std::vector<NodeId> x;
+  for (int k = 0; k < kLayerInputs; ++k) x.push_back(tape.leaf(0.01 * k));
+  NodeId loss = tape.leaf(0);
+  for (int j = 0; j < n; ++j) {
+    NodeId acc = tape.leaf(0.1);
+    for (int k = 0; k < kLayerInputs; ++k) {
+      acc = tape.add(acc, tape.mul(x[k], tape.leaf(0.5 / kLayerInputs)));
+    }
+    loss = tape.add(loss, tape.tanh(acc));
+  }
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    tape.forward(loss);
+    tape.zeroGrad();
+    tape.backward(loss);
+    benchmark::DoNotOptimize(tape.nodes[x[0]].grad);
+  }
+  counters.stop();
+  state.counters["graph_nodes"] = tape.size();
+}
+BENCHMARK(BM_Scalar_DenseLayerStep)->RangeMultiplier(10)->Range(10, 1000);
+
+static void BM_Tensor_DenseLayerStep(benchmark::State& state) {
+  const int n = state.range(0);
+  TensorTape<double> tape;
+  const NodeId x = tape.leaf(Matrix<double>::Constant(1, kLayerInputs, 0.5));
+  const NodeId w =
+      tape.leaf(Matrix<double>::Constant(kLayerInputs, n, 0.5 / kLayerInputs));
+  const NodeId b = tape.leaf(Matrix<double>::Constant(1, n, 0.1));
+  const NodeId loss = tape.sum(tape.tanh(tape.add(tape.matmul(x, w), b)));
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    tape.forward(loss);
+    tape.zeroGrad();
+    tape.backward(loss);
+    benchmark::DoNotOptimize(tape.grad(x).data());
+  }
+  counters.stop();
+  state.counters["graph_nodes"] = tape.size();
+}
+BENCHMARK(BM_Tensor_DenseLayerStep)->RangeMultiplier(10)->Range(10, 1000);
+
+// Training steps that rebuild a neuron over fixed parameters, either letting
+// the tape grow or truncating it back to the parameters after each step.
+static void BM_Tape_RebuildStepMemory(benchmark::State& state) {
+  constexpr int kInputs = 256;
+  const bool reset = state.range(0);
+  Tape<double> tape;
+  std::vector<NodeId> w;
+  for (int i = 0; i < kInputs; ++i) w.push_back(tape.leaf(0.01 * i));
+  const NodeId b = tape.leaf(0.1);
+  const size_t num_params = tape.size();
+
+  resetPeakRss();
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    NodeId sum = b;
+    for (int i = 0; i < kInputs; ++i) {
+      sum = tape.add(sum, tape.mul(tape.leaf(0.5), w[i]));
+    }
+    const NodeId loss = tape.tanh(sum);
+    tape.backward(loss);
+    for (NodeId p : w) tape.nodes[p].data -= 0.01 * tape.nodes[p].grad;
+    if (reset) tape.truncate(num_params);
+  }
+  counters.stop();
+  state.counters["peak_rss"] =
+      benchmark::Counter(peakRssBytes(), {}, benchmark::Counter::kIs1024);
+  state.counters["tape_nodes"] = tape.size();
+}
+BENCHMARK(BM_Tape_RebuildStepMemory)
+    ->Arg(0)
+    ->Arg(1)
+    ->ArgName("reset")
+    ->Iterations(2000);
+
+// Steps of a deep, narrow tanh MLP, storing every activation or keeping only
+// every 4th layer's output and recomputing the rest in the backward pass.
+static void BM_Tensor_DeepMlpStepMemory(benchmark::State& state) {
+  constexpr int kBatch = 128, kWidth = 256, kDepth = 32;
+  const bool checkpoint = state.range(0);
+  TensorTape<float> tape;
+  NodeId h = tape.leaf(Matrix<float>::Random(kBatch, kWidth));
+  std::vector<NodeId> params;
+  for (int d = 0; d < kDepth; ++d) {
+    const NodeId w = tape.leaf(Matrix<float>::Random(kWidth, kWidth) * 0.1f);
+    const NodeId b = tape.leaf(Matrix<float>::Zero(1, kWidth));
+    params.insert(params.end(), {w, b});
+    const NodeId mm = tape.matmul(h, w);
+    const NodeId pre = tape.add(mm, b);
+    h = tape.tanh(pre);
+    if (checkpoint) {
+      tape.recomputeInBackward(mm);
+      tape.recomputeInBackward(pre);
+      if (d % 4 != 3) tape.recomputeInBackward(h);
+    }
+  }
+  const NodeId loss = tape.mean(h);
+  // Warm up, so that buffers released by checkpointing are gone.
+  tape.forward(loss);
+  tape.backward(loss);
+
+  resetPeakRss();
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    tape.forward(loss);
+    tape.zeroGrad();
+    tape.backward(loss);
+    for (NodeId p : params) tape.mutableValue(p) -= 0.01f * tape.grad(p);
+  }
+  counters.stop();
+  state.counters["peak_rss"] =
+      benchmark::Counter(peakRssBytes(), {}, benchmark::Counter::kIs1024);
+}
+BENCHMARK(BM_Tensor_DeepMlpStepMemory)
+    ->Arg(0)
+    ->Arg(1)
+    ->ArgName("checkpoint")
+    ->Unit(benchmark::kMillisecond);
+
+// Data-parallel steps of a two-layer tanh MLP over a fixed global batch, split
+// into one shard per thread.
+struct MlpModel {
+  TensorTape<float> tape;
+  std::vector<NodeId> params;
+  NodeId x;
+  NodeId loss;
+};
+
+MlpModel buildMlpModel(int rows) {
+  constexpr int kIn = 64, kHidden = 256;
+  MlpModel m;
+  auto& t = m.tape;
+  m.x = t.leaf(Matrix<float>::Random(rows, kIn));
+  const NodeId w1 = t.leaf(Matrix<float>::Random(kIn, kHidden) * 0.1f);
+  const NodeId b1 = t.leaf(Matrix<float>::Zero(1, kHidden));
+  const NodeId w2 = t.leaf(Matrix<float>::Random(kHidden, kHidden) * 0.05f);
+  const NodeId b2 = t.leaf(Matrix<float>::Zero(1, kHidden));
+  m.params = {w1, b1, w2, b2};
+  const NodeId h = t.tanh(t.add(t.matmul(m.x, w1), b1));
+  m.loss = t.mean(t.tanh(t.add(t.matmul(h, w2), b2)));
+  return m;
+}
+
+constexpr int kGlobalBatch = 1024;
+
+// Thread counts that split kGlobalBatch evenly: powers of two, up to the
+// number of cores.
+static void powerOfTwoThreads(benchmark::internal::Benchmark* b) {
+  const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int t = 1; t <= max_threads && kGlobalBatch % t == 0; t *= 2) b->Arg(t);
+}
+
+static void BM_DataParallel_MlpStep(benchmark::State& state) {
+  const int num_threads = state.range(0);
+  DataParallel<MlpModel> dp(
+      [&] { return buildMlpModel(kGlobalBatch / num_threads); }, num_threads);
+  // Workers started after the counters are counted as they exit.
+  BenchmarkCounters counters(state);
+  counters.pause();
+  {
+    WorkStealingPool pool(num_threads);
+    counters.resume();
+    for (auto _ : state) {
+      const float loss = dp.step(pool, [](size_t, MlpModel&) {});
+      MlpModel& master = dp.master();
+      for (size_t i = 0; i < master.params.size(); ++i) {
+        master.tape.mutableValue(master.params[i]) -= 0.01f * dp.grad(i);
+      }
+      benchmark::DoNotOptimize(loss);
+    }
+    counters.pause();
+  }
+  counters.stop();
+  state.counters["steps/s"] =
+      benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+  state.counters["samples/s"] = benchmark::Counter(
+      double(state.iterations()) * kGlobalBatch, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_DataParallel_MlpStep)
+    ->Apply(powerOfTwoThreads)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
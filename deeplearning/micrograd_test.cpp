@@ -52,7 +52,7 @@ TEST(MicrogradTest, BackpropWithSharedNodes) {
   tree.reg(tree("d") * tree("e"), "f");
   tree.runBackprop("f");
 
-  EXPECT_EQ(5, tree.nodes.size());
+  EXPECT_EQ(5, tree.size());
 
   EXPECT_DOUBLE_EQ(-6, tree("f").data);
   EXPECT_DOUBLE_EQ(1.0, tree("f").grad);
@@ -68,4 +68,131 @@ TEST(MicrogradTest, BackpropWithSharedNodes) {
 
   EXPECT_DOUBLE_EQ(3.0, tree("b").data);
   EXPECT_DOUBLE_EQ(-8.0, tree("b").grad);
-}
\ No newline at end of file
+}
+
+TEST(MicrogradTest, TapeMatchesExprTree) {
+  // Same graph as above, built directly on the tape with integer handles.
+  Tape<double> tape;
+  const NodeId a = tape.leaf(-2.);
+  const NodeId b = tape.leaf(3.);
+  const NodeId d = tape.mul(a, b);
+  const NodeId e = tape.add(a, b);
+  const NodeId f = tape.mul(d, e);
+  tape.backward(f);
+
+  EXPECT_EQ(5, tape.size());
+  EXPECT_DOUBLE_EQ(-6, tape.nodes[f].data);
+  EXPECT_DOUBLE_EQ(-6.0, tape.nodes[e].grad);
+  EXPECT_DOUBLE_EQ(1.0, tape.nodes[d].grad);
+  EXPECT_DOUBLE_EQ(-3.0, tape.nodes[a].grad);
+  EXPECT_DOUBLE_EQ(-8.0, tape.nodes[b].grad);
+}
+
+TEST(MicrogradTest, BackpropThroughSquare) {
+  // Both operands of the product are the same node.
+  ExprTree<double> tree;
+  tree.reg(Value(3.), "a");
+  tree.reg(tree("a") * tree("a"), "b");
+  tree.reg(tree("b").tanh(), "c");
+  tree.runBackprop("c");
+
+  const double c = std::tanh(9.);
+  EXPECT_DOUBLE_EQ(c, tree("c").data);
+  EXPECT_DOUBLE_EQ(1 - c * c, tree("b").grad);
+  EXPECT_DOUBLE_EQ((1 - c * c) * 2 * 3, tree("a").grad);
+}
+
+TEST(MicrogradTest, RegisterRequiresRegisteredOperands) {
+  ExprTree<double> tree;
+  tree.reg(Value(3.), "a");
+  EXPECT_THROW(tree.reg(tree("a") * Value(2.), "b"), std::out_of_range);
+}
+
+TEST(MicrogradTest, TopologicalBackpropMatchesPathEnumeration) {
+  // A small "ladder" where every node is reused by the next two, so the
+  // number of paths from the root doubles with each rung.
+  Tape<double> sweep, paths;
+  for (auto* tape : {&sweep, &paths}) {
+    NodeId a = tape->leaf(0.3);
+    NodeId b = tape->leaf(-0.7);
+    for (int rung = 0; rung < 8; ++rung) {
+      const NodeId next_a = tape->tanh(tape->add(a, b));
+      b = tape->mul(a, b);
+      a = next_a;
+    }
+    tape->add(a, b);
+  }
+  const NodeId root = sweep.size() - 1;
+  sweep.backward(root);
+  paths.backwardByPaths(root);
+
+  for (NodeId id = 0; id < sweep.size(); ++id) {
+    EXPECT_NEAR(paths.nodes[id].grad, sweep.nodes[id].grad, 1e-12);
+  }
+}
+
+TEST(MicrogradTest, ForwardReplaysUpdatedLeaves) {
+  Tape<double> tape;
+  const NodeId x = tape.leaf(2.0);
+  const NodeId w = tape.leaf(-3.0);
+  const NodeId o = tape.tanh(tape.add(tape.mul(x, w), x));
+  tape.backward(o);
+
+  tape.nodes[x].data = 0.5;
+  tape.forward(o);
+  tape.zeroGrad();
+  tape.backward(o);
+
+  const double expected = std::tanh(0.5 * -3.0 + 0.5);
+  EXPECT_DOUBLE_EQ(expected, tape.nodes[o].data);
+  EXPECT_DOUBLE_EQ((1 - expected * expected) * (-3.0 + 1), tape.nodes[x].grad);
+  EXPECT_DOUBLE_EQ((1 - expected * expected) * 0.5, tape.nodes[w].grad);
+}
+
+TEST(MicrogradTest, TruncateEndsAStep) {
+  Tape<double> tape;
+  const NodeId w = tape.leaf(0.5);
+  const NodeId b = tape.leaf(0.1);
+  const size_t num_params = tape.size();
+
+  for (int step = 0; step < 4; ++step) {
+    const double input = step + 1.0;
+    // Both graphs have the same size and root id, but the odd steps reach an
+    // extra node, so a stale cached order would skip it.
+    const NodeId x = tape.leaf(input);
+    const NodeId xw = tape.mul(x, w);
+    const NodeId sum = tape.add(step % 2 == 0 ? x : xw, b);
+    const NodeId loss = tape.tanh(step % 2 == 0 ? xw : sum);
+    tape.backward(loss);
+
+    const double t = tape.nodes[loss].data;
+    EXPECT_DOUBLE_EQ((1 - t * t) * input, tape.nodes[w].grad);
+    EXPECT_DOUBLE_EQ(step % 2 == 0 ? 0.0 : 1 - t * t, tape.nodes[b].grad);
+
+    const size_t capacity = tape.nodes.capacity();
+    tape.truncate(num_params);
+    EXPECT_EQ(num_params, tape.size());
+    EXPECT_EQ(capacity, tape.nodes.capacity());
+    EXPECT_EQ(0.0, tape.nodes[w].grad);
+    EXPECT_EQ(0.0, tape.nodes[b].grad);
+  }
+}
+
+TEST(MicrogradTest, TruncateForgetsLabels) {
+  ExprTree<double> tree;
+  tree.reg(Value(3.), "w");
+  tree.reg(Value(2.), "x");
+  tree.reg(tree("w") * tree("x"), "y");
+  tree.runBackprop("y");
+  tree.truncate(1);
+
+  EXPECT_EQ(1, tree.size());
+  EXPECT_EQ(0.0, tree("w").grad);
+  EXPECT_THROW(tree("x"), std::out_of_range);
+  EXPECT_THROW(tree("y"), std::out_of_range);
+
+  tree.reg(Value(4.), "x");
+  tree.reg(tree("w") * tree("x"), "y");
+  tree.runBackprop("y");
+  EXPECT_DOUBLE_EQ(4.0, tree("w").grad);
+}
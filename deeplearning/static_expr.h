@@ -0,0 +1,150 @@
+#ifndef DEEPLEARNING_STATIC_EXPR_H_
+#define DEEPLEARNING_STATIC_EXPR_H_
+
+// Expression templates for small models whose structure is known at compile
+// time, such as a single neuron:
+//
+//   constexpr StaticVar<double, 0> x1;
+//   constexpr StaticVar<double, 1> w1;
+//   ...
+//   auto o = (x1 * w1 + x2 * w2 + b).tanh();
+//   std::array<double, 5> inputs = {...}, grads;
+//   o.forward(inputs);
+//   o.backward(grads);
+//
+// The type of `o` is the graph, so forward() and backward() inline into
+// straight-line code: no heap, no hashing and no dispatch on the op. Each
+// node keeps its value from the last forward() for backward() to use.
+//
+// Expressions are trees: a subexpression used twice is stored and evaluated
+// twice. Gradients are still exact, since they add up over both copies.
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+template <typename E>
+struct StaticTanh;
+
+// CRTP base of every node type.
+template <typename Derived>
+struct StaticExpr {
+  constexpr StaticTanh<Derived> tanh() const {
+    return StaticTanh<Derived>(static_cast<const Derived&>(*this));
+  }
+
+  // Zeroes `grads` and backpropagates from this node, which must have been
+  // evaluated by forward().
+  template <typename T, size_t N>
+  constexpr void backward(std::array<T, N>& grads) const {
+    grads.fill(T{0});
+    static_cast<const Derived&>(*this).propagate(T{1}, grads);
+  }
+};
+
+template <typename E>
+inline constexpr bool kIsStaticExpr =
+    std::is_base_of_v<StaticExpr<std::remove_cvref_t<E>>,
+                      std::remove_cvref_t<E>>;
+
+// Input number I, read from the array passed to forward().
+template <typename T, size_t I>
+struct StaticVar : StaticExpr<StaticVar<T, I>> {
+  using Scalar = T;
+
+  template <size_t N>
+  constexpr T forward(const std::array<T, N>& inputs) {
+    static_assert(I < N, "Not enough inputs for this expression");
+    value = inputs[I];
+    return value;
+  }
+
+  template <size_t N>
+  constexpr void propagate(T grad, std::array<T, N>& grads) const {
+    grads[I] += grad;
+  }
+
+  T value{};
+};
+
+template <typename L, typename R>
+struct StaticAdd : StaticExpr<StaticAdd<L, R>> {
+  using Scalar = typename L::Scalar;
+
+  constexpr StaticAdd(const L& l, const R& r) : l(l), r(r) {}
+
+  template <size_t N>
+  constexpr Scalar forward(const std::array<Scalar, N>& inputs) {
+    value = l.forward(inputs) + r.forward(inputs);
+    return value;
+  }
+
+  template <size_t N>
+  constexpr void propagate(Scalar grad, std::array<Scalar, N>& grads) const {
+    l.propagate(grad, grads);
+    r.propagate(grad, grads);
+  }
+
+  L l;
+  R r;
+  Scalar value{};
+};
+
+template <typename L, typename R>
+struct StaticMul : StaticExpr<StaticMul<L, R>> {
+  using Scalar = typename L::Scalar;
+
+  constexpr StaticMul(const L& l, const R& r) : l(l), r(r) {}
+
+  template <size_t N>
+  constexpr Scalar forward(const std::array<Scalar, N>& inputs) {
+    value = l.forward(inputs) * r.forward(inputs);
+    return value;
+  }
+
+  template <size_t N>
+  constexpr void propagate(Scalar grad, std::array<Scalar, N>& grads) const {
+    l.propagate(grad * r.value, grads);
+    r.propagate(grad * l.value, grads);
+  }
+
+  L l;
+  R r;
+  Scalar value{};
+};
+
+template <typename E>
+struct StaticTanh : StaticExpr<StaticTanh<E>> {
+  using Scalar = typename E::Scalar;
+
+  constexpr explicit StaticTanh(const E& e) : e(e) {}
+
+  template <size_t N>
+  constexpr Scalar forward(const std::array<Scalar, N>& inputs) {
+    value = std::tanh(e.forward(inputs));
+    return value;
+  }
+
+  template <size_t N>
+  constexpr void propagate(Scalar grad, std::array<Scalar, N>& grads) const {
+    e.propagate(grad * (1 - value * value), grads);
+  }
+
+  E e;
+  Scalar value{};
+};
+
+template <typename L, typename R>
+  requires(kIsStaticExpr<L> && kIsStaticExpr<R>)
+constexpr StaticAdd<L, R> operator+(const L& l, const R& r) {
+  return {l, r};
+}
+
+template <typename L, typename R>
+  requires(kIsStaticExpr<L> && kIsStaticExpr<R>)
+constexpr StaticMul<L, R> operator*(const L& l, const R& r) {
+  return {l, r};
+}
+
+#endif  // DEEPLEARNING_STATIC_EXPR_H_
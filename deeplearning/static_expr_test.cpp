@@ -0,0 +1,94 @@
+#include "static_expr.h"
+
+#include <gtest/gtest.h>
+
+#include <type_traits>
+
+#include "gmock/gmock.h"
+#include "micrograd.h"
+
+TEST(StaticExprTest, NeuronMatchesExprTree) {
+  // The neuron from gen_dot_graph.cpp.
+  ExprTree<double> neuron;
+  neuron.reg(Value(2.0), "x1");
+  neuron.reg(Value(0.0), "x2");
+  neuron.reg(Value(-3.0), "w1");
+  neuron.reg(Value(1.0), "w2");
+  neuron.reg(Value(6.8813735870195432), "bias");
+  neuron.reg(neuron("x1") * neuron("w1"), "x1w1");
+  neuron.reg(neuron("x2") * neuron("w2"), "x2w2");
+  neuron.reg(neuron("x1w1") + neuron("x2w2"), "x1w1+x2w2");
+  neuron.reg(neuron("x1w1+x2w2") + neuron("bias"), "n");
+  neuron.reg(neuron("n").tanh(), "o");
+  neuron.runBackprop("o");
+
+  constexpr StaticVar<double, 0> x1;
+  constexpr StaticVar<double, 1> x2;
+  constexpr StaticVar<double, 2> w1;
+  constexpr StaticVar<double, 3> w2;
+  constexpr StaticVar<double, 4> bias;
+  auto o = (x1 * w1 + x2 * w2 + bias).tanh();
+
+  const std::array<double, 5> inputs = {
+      2.0, 0.0, -3.0, 1.0, 6.8813735870195432};
+  std::array<double, 5> grads;
+  EXPECT_DOUBLE_EQ(neuron("o").data, o.forward(inputs));
+  o.backward(grads);
+
+  const char* labels[] = {"x1", "x2", "w1", "w2", "bias"};
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_DOUBLE_EQ(neuron(labels[i]).grad, grads[i]) << labels[i];
+  }
+}
+
+TEST(StaticExprTest, SharedSubexpressionsMatchExprTree) {
+  // The graph from BackpropWithSharedNodes in micrograd_test.cpp, where d and
+  // e are each used twice.
+  ExprTree<double> tree;
+  tree.reg(Value(-2.), "a");
+  tree.reg(Value(3.), "b");
+  tree.reg(tree("a") * tree("b"), "d");
+  tree.reg(tree("a") + tree("b"), "e");
+  tree.reg(tree("d") * tree("e"), "f");
+  tree.reg(tree("f") + tree("e"), "g");
+  tree.reg(tree("g").tanh(), "h");
+  tree.runBackprop("h");
+
+  constexpr StaticVar<double, 0> a;
+  constexpr StaticVar<double, 1> b;
+  constexpr auto d = a * b;
+  constexpr auto e = a + b;
+  auto h = (d * e + e).tanh();
+
+  std::array<double, 2> grads;
+  EXPECT_DOUBLE_EQ(tree("h").data, h.forward(std::array{-2., 3.}));
+  h.backward(grads);
+  EXPECT_DOUBLE_EQ(tree("a").grad, grads[0]);
+  EXPECT_DOUBLE_EQ(tree("b").grad, grads[1]);
+}
+
+TEST(StaticExprTest, ReplayOverNewInputs) {
+  constexpr StaticVar<float, 0> x;
+  constexpr StaticVar<float, 1> w;
+  auto y = (x * w).tanh();
+  std::array<float, 2> grads;
+  for (float input : {-1.0f, 0.5f, 2.0f}) {
+    const float out = y.forward(std::array{input, 0.25f});
+    EXPECT_FLOAT_EQ(std::tanh(input * 0.25f), out);
+    y.backward(grads);
+    EXPECT_FLOAT_EQ((1 - out * out) * 0.25f, grads[0]);
+    EXPECT_FLOAT_EQ((1 - out * out) * input, grads[1]);
+  }
+}
+
+TEST(StaticExprTest, GraphIsATypeWithNoIndirection) {
+  constexpr StaticVar<double, 0> x;
+  constexpr StaticVar<double, 1> w;
+  using Neuron = decltype((x * w + x).tanh());
+  static_assert(std::is_same_v<
+                Neuron,
+                StaticTanh<StaticAdd<
+                    StaticMul<StaticVar<double, 0>, StaticVar<double, 1>>,
+                    StaticVar<double, 0>>>>);
+  static_assert(std::is_trivially_copyable_v<Neuron>);
+}
@@ -0,0 +1,432 @@
+#ifndef DEEPLEARNING_TENSOR_H_
+#define DEEPLEARNING_TENSOR_H_
+
+// Tensor-valued counterpart of Tape: each node holds a whole matrix, so a
+// dense layer is a handful of nodes instead of one node per multiply-add.
+// Forward kernels are Eigen expressions (vectorized GEMM and packet math for
+// the elementwise ops), and each op has a hand-written backward.
+
+#include <Eigen/Core>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "micrograd.h"
+
+template <typename T>
+using Matrix =
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+enum class TensorOp {
+  Leaf,
+  MatMul,  // (m x k) * (k x n)
+  Add,     // Elementwise, same shapes.
+  AddRow,  // (m x n) + (1 x n), broadcasting the row (e.g. a bias).
+  Mul,     // Elementwise, same shapes.
+  Tanh,
+  Exp,
+  Sum,   // All elements, to 1 x 1.
+  Mean,  // All elements, to 1 x 1.
+  // Rows of a table (e.g. an embedding) by index, with each output row
+  // concatenating a fixed number of consecutive lookups.
+  Gather,
+  // Mean softmax cross-entropy of (batch x classes) logits against target
+  // class indices, to 1 x 1.
+  CrossEntropy,
+};
+
+inline int numChildren(TensorOp op) {
+  switch (op) {
+    case TensorOp::Leaf:
+      return 0;
+    case TensorOp::Tanh:
+    case TensorOp::Exp:
+    case TensorOp::Sum:
+    case TensorOp::Mean:
+    case TensorOp::Gather:
+    case TensorOp::CrossEntropy:
+      return 1;
+    default:
+      return 2;
+  }
+}
+
+template <typename T>
+struct TensorNode {
+  TensorOp op;
+  std::array<NodeId, 2> children;
+  Matrix<T> value;
+  // Allocated when a gradient first flows into the node.
+  Matrix<T> grad;
+  // Row indices for Gather, target classes for CrossEntropy.
+  std::vector<int32_t> indices;
+  // Set for leaves that read their value from storage owned elsewhere (e.g.
+  // parameters shared by several replicas of a model).
+  const Matrix<T>* shared = nullptr;
+  // Set for activations that are released once forward() no longer needs
+  // them and recomputed when backward() does (see recomputeInBackward).
+  bool recompute = false;
+};
+
+template <typename T>
+class TensorTape {
+ public:
+  using Scalar = T;
+
+  NodeId leaf(Matrix<T> value) {
+    nodes.push_back(
+        {TensorOp::Leaf, {kNoNode, kNoNode}, std::move(value), {}, {}});
+    return static_cast<NodeId>(nodes.size() - 1);
+  }
+
+  NodeId matmul(NodeId a, NodeId b) {
+    assert(value(a).cols() == value(b).rows());
+    return push(TensorOp::MatMul, a, b);
+  }
+
+  NodeId add(NodeId a, NodeId b) {
+    if (value(b).rows() == 1 && value(a).rows() != 1) {
+      assert(value(a).cols() == value(b).cols());
+      return push(TensorOp::AddRow, a, b);
+    }
+    assert(value(a).rows() == value(b).rows());
+    assert(value(a).cols() == value(b).cols());
+    return push(TensorOp::Add, a, b);
+  }
+
+  NodeId mul(NodeId a, NodeId b) {
+    assert(value(a).rows() == value(b).rows());
+    assert(value(a).cols() == value(b).cols());
+    return push(TensorOp::Mul, a, b);
+  }
+
+  NodeId tanh(NodeId a) { return push(TensorOp::Tanh, a); }
+  NodeId exp(NodeId a) { return push(TensorOp::Exp, a); }
+  NodeId sum(NodeId a) { return push(TensorOp::Sum, a); }
+  NodeId mean(NodeId a) { return push(TensorOp::Mean, a); }
+
+  // Looks up rows of `table`. Each output row concatenates `per_row`
+  // consecutive lookups, so the result is
+  // (indices.size() / per_row) x (per_row * table.cols()).
+  NodeId gather(NodeId table, std::vector<int32_t> indices, int per_row = 1) {
+    assert(per_row > 0);
+    assert(!indices.empty());
+    assert(indices.size() % per_row == 0);
+    nodes.push_back({TensorOp::Gather, {table, kNoNode}, {}, {}, {}});
+    auto& node = nodes.back();
+    node.value.resize(indices.size() / per_row, per_row * value(table).cols());
+    node.indices = std::move(indices);
+    compute(node);
+    return static_cast<NodeId>(nodes.size() - 1);
+  }
+
+  NodeId crossEntropy(NodeId logits, std::vector<int32_t> targets) {
+    assert(targets.size() == static_cast<size_t>(value(logits).rows()));
+    nodes.push_back({TensorOp::CrossEntropy, {logits, kNoNode}, {}, {}, {}});
+    auto& node = nodes.back();
+    node.indices = std::move(targets);
+    compute(node);
+    return static_cast<NodeId>(nodes.size() - 1);
+  }
+
+  // Mutable access for replaying a graph over new inputs: leaf values, and the
+  // indices of Gather and CrossEntropy nodes (which must keep their size).
+  Matrix<T>& mutableValue(NodeId id) {
+    assert(nodes[id].shared == nullptr);
+    return nodes[id].value;
+  }
+  std::vector<int32_t>& mutableIndices(NodeId id) { return nodes[id].indices; }
+  Matrix<T>& mutableGrad(NodeId id) { return nodes[id].grad; }
+
+  // Makes `leaf` read its value from `storage` instead of its own copy, which
+  // is released. `storage` must outlive the tape and keep its address, and
+  // must keep its shape between steps.
+  void share(NodeId leaf, const Matrix<T>& storage) {
+    assert(nodes[leaf].op == TensorOp::Leaf);
+    assert(storage.rows() == value(leaf).rows());
+    assert(storage.cols() == value(leaf).cols());
+    nodes[leaf].shared = &storage;
+    nodes[leaf].value = Matrix<T>();
+  }
+
+  // Gradient checkpointing: `id` keeps no value or gradient between passes.
+  // forward() releases its value after its last use, and backward()
+  // recomputes it from the nearest kept ancestors (the checkpoints) when it
+  // is needed, then releases it again. Marking all but every k-th layer's
+  // output trades one extra forward pass for keeping only the checkpoints
+  // and one segment of activations alive at a time.
+  //
+  // Released buffers are reallocated on every step. The value of a marked
+  // node is only valid during construction.
+  void recomputeInBackward(NodeId id) {
+    // Leaves can't be recomputed, and Gather sizes its buffer at
+    // construction.
+    assert(nodes[id].op != TensorOp::Leaf);
+    assert(nodes[id].op != TensorOp::Gather);
+    if (!nodes[id].recompute) ++num_recomputed_;
+    nodes[id].recompute = true;
+  }
+
+  const Matrix<T>& value(NodeId id) const {
+    const auto& node = nodes[id];
+    return node.shared == nullptr ? node.value : *node.shared;
+  }
+  const Matrix<T>& grad(NodeId id) const { return nodes[id].grad; }
+
+  size_t size() const { return nodes.size(); }
+
+  // Recomputes every non-leaf node up to `root` from the current leaf values.
+  // Node buffers are reused, so a replay over same-shaped inputs doesn't
+  // allocate (unless some nodes are recomputed in backward), apart from the
+  // packing buffers Eigen allocates for large matrix products.
+  void forward(NodeId root) {
+    if (num_recomputed_ == 0) {
+      for (NodeId id = 0; id <= root; ++id) compute(nodes[id]);
+      return;
+    }
+    std::vector<NodeId> last_use(root + 1, kNoNode);
+    for (NodeId id = 0; id <= root; ++id) {
+      for (int i = 0; i < numChildren(nodes[id].op); ++i) {
+        last_use[nodes[id].children[i]] = id;
+      }
+    }
+    for (NodeId id = 0; id <= root; ++id) {
+      const auto& node = nodes[id];
+      compute(nodes[id]);
+      for (int i = 0; i < numChildren(node.op); ++i) {
+        const NodeId child = node.children[i];
+        if (nodes[child].recompute && last_use[child] == id) release(child);
+      }
+    }
+  }
+
+  // Reverse sweep from `root`, which must be a 1 x 1 node (e.g. a loss).
+  // Operands precede their results on the tape, so visiting ids in
+  // decreasing order sees each node's complete gradient before its operands.
+  void backward(NodeId root) {
+    assert(value(root).size() == 1);
+    nodes[root].grad.setOnes(1, 1);
+    const std::vector<bool>& reached = reachableFrom(root);
+    for (NodeId id = root + 1; id-- > 0;) {
+      if (!reached[id]) continue;
+      const auto& node = nodes[id];
+      if (num_recomputed_ > 0) {
+        materialize(id);
+        for (int i = 0; i < numChildren(node.op); ++i) {
+          materialize(node.children[i]);
+        }
+      }
+      propagate(node);
+      // Every consumer of this node has a larger id, so none needs it again.
+      if (node.recompute && id != root) release(id);
+    }
+  }
+
+  // Zeroes gradients in place, keeping their buffers for the next step.
+  void zeroGrad() {
+    for (auto& node : nodes) node.grad.setZero();
+  }
+
+  std::vector<TensorNode<T>> nodes;
+
+ private:
+  // Which nodes `root` depends on, indexed by id up to `root`. Cached until
+  // the tape grows or the root changes, so replayed steps don't rebuild it.
+  const std::vector<bool>& reachableFrom(NodeId root) {
+    if (root == reachable_root_ && nodes.size() == reachable_tape_size_) {
+      return reachable_;
+    }
+    // A single downward scan from the root marks everything reachable, since
+    // each node's operands have smaller ids than the node itself.
+    reachable_.assign(root + 1, false);
+    reachable_[root] = true;
+    for (NodeId id = root + 1; id-- > 0;) {
+      if (!reachable_[id]) continue;
+      const auto& node = nodes[id];
+      for (int i = 0; i < numChildren(node.op); ++i) {
+        reachable_[node.children[i]] = true;
+      }
+    }
+    reachable_root_ = root;
+    reachable_tape_size_ = nodes.size();
+    return reachable_;
+  }
+
+  void release(NodeId id) {
+    nodes[id].value = Matrix<T>();
+    nodes[id].grad = Matrix<T>();
+  }
+
+  // Recomputes a released node, and whichever of its operands were released
+  // too. They stay materialized until backward() has propagated them.
+  void materialize(NodeId id) {
+    auto& node = nodes[id];
+    if (!node.recompute || node.value.size() != 0) return;
+    for (int i = 0; i < numChildren(node.op); ++i) {
+      materialize(node.children[i]);
+    }
+    compute(node);
+  }
+
+  NodeId push(TensorOp op, NodeId a, NodeId b = kNoNode) {
+    nodes.push_back({op, {a, b}, {}, {}, {}});
+    compute(nodes.back());
+    return static_cast<NodeId>(nodes.size() - 1);
+  }
+
+  void compute(TensorNode<T>& node) {
+    const auto& c = node.children;
+    switch (node.op) {
+      case TensorOp::Leaf:
+        break;
+      case TensorOp::MatMul:
+        node.value.noalias() = value(c[0]) * value(c[1]);
+        break;
+      case TensorOp::Add:
+        node.value = value(c[0]) + value(c[1]);
+        break;
+      case TensorOp::AddRow:
+        node.value = value(c[0]).rowwise() + value(c[1]).row(0);
+        break;
+      case TensorOp::Mul:
+        node.value = value(c[0]).cwiseProduct(value(c[1]));
+        break;
+      case TensorOp::Tanh:
+        node.value = value(c[0]).array().tanh().matrix();
+        break;
+      case TensorOp::Exp:
+        node.value = value(c[0]).array().exp().matrix();
+        break;
+      case TensorOp::Sum:
+        node.value.resize(1, 1);
+        node.value(0, 0) = value(c[0]).sum();
+        break;
+      case TensorOp::Mean:
+        node.value.resize(1, 1);
+        node.value(0, 0) = value(c[0]).mean();
+        break;
+      case TensorOp::Gather: {
+        const auto& table = value(c[0]);
+        const Eigen::Index dim = table.cols();
+        const size_t per_row = node.indices.size() / node.value.rows();
+        for (size_t i = 0; i < node.indices.size(); ++i) {
+          node.value.row(i / per_row).segment((i % per_row) * dim, dim) =
+              table.row(node.indices[i]);
+        }
+        break;
+      }
+      case TensorOp::CrossEntropy: {
+        const auto& logits = value(c[0]);
+        T total = 0;
+        for (Eigen::Index i = 0; i < logits.rows(); ++i) {
+          const auto row = logits.row(i).array();
+          const T max = row.maxCoeff();
+          total += max + std::log((row - max).exp().sum()) -
+                   row(node.indices[i]);
+        }
+        node.value.resize(1, 1);
+        node.value(0, 0) = total / logits.rows();
+        break;
+      }
+    }
+  }
+
+  // Adds `delta` to the gradient of `id`, allocating it on first use.
+  // `delta` never reads that gradient, so products are evaluated straight
+  // into it, without a temporary.
+  template <typename Expr>
+  void accumulate(NodeId id, const Expr& delta) {
+    auto& grad = nodes[id].grad;
+    if (grad.size() == 0) {
+      grad.noalias() = delta;
+    } else {
+      grad.noalias() += delta;
+    }
+  }
+
+  // The gradient of `id`, allocated and zeroed if nothing has flowed into it
+  // yet, for ops that scatter into it.
+  Matrix<T>& gradBuffer(NodeId id) {
+    auto& grad = nodes[id].grad;
+    if (grad.size() == 0) grad.setZero(value(id).rows(), value(id).cols());
+    return grad;
+  }
+
+  void propagate(const TensorNode<T>& node) {
+    const auto& c = node.children;
+    const Matrix<T>& g = node.grad;
+    switch (node.op) {
+      case TensorOp::Leaf:
+        break;
+      case TensorOp::MatMul:
+        accumulate(c[0], g * value(c[1]).transpose());
+        accumulate(c[1], value(c[0]).transpose() * g);
+        break;
+      case TensorOp::Add:
+        accumulate(c[0], g);
+        accumulate(c[1], g);
+        break;
+      case TensorOp::AddRow:
+        accumulate(c[0], g);
+        accumulate(c[1], g.colwise().sum());
+        break;
+      case TensorOp::Mul:
+        accumulate(c[0], g.cwiseProduct(value(c[1])));
+        accumulate(c[1], g.cwiseProduct(value(c[0])));
+        break;
+      case TensorOp::Tanh:
+        accumulate(c[0],
+                   (g.array() * (1 - node.value.array().square())).matrix());
+        break;
+      case TensorOp::Exp:
+        accumulate(c[0], g.cwiseProduct(node.value));
+        break;
+      case TensorOp::Sum:
+        accumulate(c[0],
+                   Matrix<T>::Constant(
+                       value(c[0]).rows(), value(c[0]).cols(), g(0, 0)));
+        break;
+      case TensorOp::Mean:
+        accumulate(c[0],
+                   Matrix<T>::Constant(value(c[0]).rows(),
+                                       value(c[0]).cols(),
+                                       g(0, 0) / value(c[0]).size()));
+        break;
+      case TensorOp::Gather: {
+        auto& table_grad = gradBuffer(c[0]);
+        const Eigen::Index dim = table_grad.cols();
+        const size_t per_row = node.indices.size() / g.rows();
+        for (size_t i = 0; i < node.indices.size(); ++i) {
+          table_grad.row(node.indices[i]) +=
+              g.row(i / per_row).segment((i % per_row) * dim, dim);
+        }
+        break;
+      }
+      case TensorOp::CrossEntropy: {
+        // d/dlogits = (softmax(logits) - onehot(target)) / batch.
+        const auto& logits = value(c[0]);
+        auto& logits_grad = gradBuffer(c[0]);
+        const T scale = g(0, 0) / logits.rows();
+        for (Eigen::Index i = 0; i < logits.rows(); ++i) {
+          const auto row = logits.row(i).array();
+          probs_ = (row - row.maxCoeff()).exp();
+          const T norm = scale / probs_.sum();
+          logits_grad.row(i).array() += probs_ * norm;
+          logits_grad(i, node.indices[i]) -= scale;
+        }
+        break;
+      }
+    }
+  }
+
+  size_t num_recomputed_ = 0;
+  // Unnormalized softmax of one row, reused by CrossEntropy's backward.
+  Eigen::Array<T, 1, Eigen::Dynamic> probs_;
+  std::vector<bool> reachable_;
+  NodeId reachable_root_ = kNoNode;
+  size_t reachable_tape_size_ = 0;
+};
+
+#endif  // DEEPLEARNING_TENSOR_H_
@@ -0,0 +1,192 @@
+#include "tensor.h"
+
+#include <gtest/gtest.h>
+
+#include "gmock/gmock.h"
+#include "micrograd.h"
+
+namespace {
+
+Matrix<double> sequence(int rows, int cols, double scale) {
+  Matrix<double> m(rows, cols);
+  for (int i = 0; i < m.size(); ++i) {
+    m.data()[i] = scale * std::sin(1.0 + i);
+  }
+  return m;
+}
+
+}  // namespace
+
+TEST(TensorTest, DenseLayerMatchesScalarGraph) {
+  // loss = sum(tanh(x * w + b)) for a batch of 3 inputs with 4 features and
+  // 5 output neurons.
+  const Matrix<double> x = sequence(3, 4, 1.0);
+  const Matrix<double> w = sequence(4, 5, 0.5);
+  const Matrix<double> b = sequence(1, 5, 0.1);
+
+  TensorTape<double> tt;
+  const NodeId tx = tt.leaf(x);
+  const NodeId tw = tt.leaf(w);
+  const NodeId tb = tt.leaf(b);
+  const NodeId loss = tt.sum(tt.tanh(tt.add(tt.matmul(tx, tw), tb)));
+  tt.backward(loss);
+
+  Tape<double> st;
+  Matrix<NodeId> sx(3, 4), sw(4, 5), sb(1, 5);
+  for (int i = 0; i < x.size(); ++i) sx.data()[i] = st.leaf(x.data()[i]);
+  for (int i = 0; i < w.size(); ++i) sw.data()[i] = st.leaf(w.data()[i]);
+  for (int i = 0; i < b.size(); ++i) sb.data()[i] = st.leaf(b.data()[i]);
+  NodeId total = st.leaf(0);
+  for (int r = 0; r < 3; ++r) {
+    for (int c = 0; c < 5; ++c) {
+      NodeId acc = sb(0, c);
+      for (int k = 0; k < 4; ++k) acc = st.add(acc, st.mul(sx(r, k), sw(k, c)));
+      total = st.add(total, st.tanh(acc));
+    }
+  }
+  st.backward(total);
+
+  EXPECT_NEAR(st.nodes[total].data, tt.value(loss)(0, 0), 1e-12);
+  for (int i = 0; i < x.size(); ++i) {
+    EXPECT_NEAR(st.nodes[sx.data()[i]].grad, tt.grad(tx).data()[i], 1e-12);
+  }
+  for (int i = 0; i < w.size(); ++i) {
+    EXPECT_NEAR(st.nodes[sw.data()[i]].grad, tt.grad(tw).data()[i], 1e-12);
+  }
+  for (int i = 0; i < b.size(); ++i) {
+    EXPECT_NEAR(st.nodes[sb.data()[i]].grad, tt.grad(tb).data()[i], 1e-12);
+  }
+}
+
+TEST(TensorTest, GradientsMatchFiniteDifferences) {
+  // loss = mean(exp(a * b) * a), with `a` used twice.
+  auto build = [](TensorTape<double>& tape, const Matrix<double>& a) {
+    const NodeId na = tape.leaf(a);
+    const NodeId nb = tape.leaf(sequence(2, 3, 0.7));
+    return std::make_pair(
+        na, tape.mean(tape.mul(tape.exp(tape.mul(na, nb)), na)));
+  };
+
+  const Matrix<double> a = sequence(2, 3, 0.3);
+  TensorTape<double> tape;
+  const auto [na, loss] = build(tape, a);
+  tape.backward(loss);
+
+  const double h = 1e-6;
+  for (int i = 0; i < a.size(); ++i) {
+    Matrix<double> up = a, down = a;
+    up.data()[i] += h;
+    down.data()[i] -= h;
+    TensorTape<double> t_up, t_down;
+    const double f_up = t_up.value(build(t_up, up).second)(0, 0);
+    const double f_down = t_down.value(build(t_down, down).second)(0, 0);
+    EXPECT_NEAR((f_up - f_down) / (2 * h), tape.grad(na).data()[i], 1e-8);
+  }
+}
+
+TEST(TensorTest, ForwardReplayAndZeroGrad) {
+  TensorTape<double> tape;
+  const NodeId x = tape.leaf(sequence(2, 2, 1.0));
+  const NodeId loss = tape.sum(tape.mul(x, x));
+  tape.backward(loss);
+
+  tape.nodes[x].value = Matrix<double>::Constant(2, 2, 3.0);
+  tape.forward(loss);
+  tape.zeroGrad();
+  tape.backward(loss);
+
+  EXPECT_DOUBLE_EQ(36.0, tape.value(loss)(0, 0));
+  EXPECT_TRUE(tape.grad(x).isApprox(Matrix<double>::Constant(2, 2, 6.0)));
+}
+
+TEST(TensorTest, EmbeddingCrossEntropyMatchesFiniteDifferences) {
+  // Two lookups per output row into a 4 x 2 table, then logits over 3
+  // classes for a batch of 3.
+  const std::vector<int32_t> indices = {0, 3, 3, 1, 2, 2};
+  const std::vector<int32_t> targets = {2, 0, 1};
+  auto build = [&](TensorTape<double>& tape, const Matrix<double>& table) {
+    const NodeId nt = tape.leaf(table);
+    const NodeId emb = tape.gather(nt, indices, 2);
+    const NodeId w = tape.leaf(sequence(4, 3, 0.9));
+    return std::make_pair(
+        nt, tape.crossEntropy(tape.matmul(emb, w), targets));
+  };
+
+  const Matrix<double> table = sequence(4, 2, 1.0);
+  TensorTape<double> tape;
+  const auto [nt, loss] = build(tape, table);
+  EXPECT_EQ(3, tape.value(nt + 1).rows());
+  EXPECT_EQ(4, tape.value(nt + 1).cols());
+  EXPECT_DOUBLE_EQ(table(3, 1), tape.value(nt + 1)(0, 3));
+  tape.backward(loss);
+
+  const double h = 1e-6;
+  for (int i = 0; i < table.size(); ++i) {
+    Matrix<double> up = table, down = table;
+    up.data()[i] += h;
+    down.data()[i] -= h;
+    TensorTape<double> t_up, t_down;
+    const double f_up = t_up.value(build(t_up, up).second)(0, 0);
+    const double f_down = t_down.value(build(t_down, down).second)(0, 0);
+    EXPECT_NEAR((f_up - f_down) / (2 * h), tape.grad(nt).data()[i], 1e-8);
+  }
+}
+
+TEST(TensorTest, CheckpointingMatchesStoredActivations) {
+  constexpr int kDepth = 8;
+  constexpr int kWidth = 5;
+  struct Net {
+    TensorTape<double> tape;
+    NodeId x, loss;
+    std::vector<NodeId> params, activations;
+  };
+  auto build = [&](bool checkpoint) {
+    Net net;
+    auto& t = net.tape;
+    net.x = t.leaf(sequence(3, kWidth, 1.0));
+    NodeId h = net.x;
+    for (int d = 0; d < kDepth; ++d) {
+      const NodeId w = t.leaf(sequence(kWidth, kWidth, 0.5 / (d + 1)));
+      const NodeId b = t.leaf(sequence(1, kWidth, 0.1));
+      net.params.insert(net.params.end(), {w, b});
+      const NodeId mm = t.matmul(h, w);
+      const NodeId pre = t.add(mm, b);
+      h = t.tanh(pre);
+      net.activations.insert(net.activations.end(), {mm, pre, h});
+      // Keep every third layer's output as a checkpoint.
+      if (checkpoint) {
+        t.recomputeInBackward(mm);
+        t.recomputeInBackward(pre);
+        if (d % 3 != 2) t.recomputeInBackward(h);
+      }
+    }
+    net.loss = t.mean(t.mul(h, h));
+    return net;
+  };
+
+  Net stored = build(false);
+  Net recomputed = build(true);
+  for (double input : {1.0, -2.0}) {
+    for (Net* net : {&stored, &recomputed}) {
+      net->tape.mutableValue(net->x) = sequence(3, kWidth, input);
+      net->tape.forward(net->loss);
+      net->tape.zeroGrad();
+      net->tape.backward(net->loss);
+    }
+    // The same operations in the same order, so results are identical.
+    EXPECT_EQ(stored.tape.value(stored.loss),
+              recomputed.tape.value(recomputed.loss));
+    for (size_t i = 0; i < stored.params.size(); ++i) {
+      EXPECT_EQ(stored.tape.grad(stored.params[i]),
+                recomputed.tape.grad(recomputed.params[i]));
+    }
+    EXPECT_EQ(stored.tape.grad(stored.x), recomputed.tape.grad(recomputed.x));
+
+    // Only the checkpoints hold on to their buffers.
+    int live = 0;
+    for (NodeId id : recomputed.activations) {
+      if (recomputed.tape.value(id).size() != 0) ++live;
+    }
+    EXPECT_EQ(kDepth / 3, live);
+  }
+}
@@ -0,0 +1,284 @@
+#ifndef MONTECARLO_NASCH_H_
+#define MONTECARLO_NASCH_H_
+
+// Headless Nagel-Schreckenberg traffic model on a single-lane ring road.
+// As described in Art Owen's "Monte Carlo theory, methods and examples"
+// https://artowen.su.domains/mc/
+//
+// Each step, every vehicle simultaneously
+//   1. accelerates by 1, up to max_velocity,
+//   2. slows down to the number of empty cells ahead of it (its gap),
+//   3. with probability slowdown_p, slows down by 1 more (if moving),
+//   4. moves ahead by its velocity.
+//
+// State is stored as structure-of-arrays, double-buffered: a step reads the
+// current position and velocity arrays and writes the other pair. Vehicles
+// never overtake, so index i + 1 (mod n) is always the vehicle ahead of i and
+// gaps need no search. Nothing here renders; see traffic.cpp for a viewer.
+//
+// step() applies the rules one vehicle at a time. stepVectorized() applies
+// the same rules to kLanes vehicles at once with GCC/Clang vector extensions
+// (SSE2 or NEON at the baseline ISA), branch-free, after drawing all of the
+// step's random bits in one pass. Both sample the same model, but from
+// different draws, so they agree in distribution rather than step by step.
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "absl/random/random.h"
+
+struct NaSchParams {
+  int32_t num_cells = 1000;
+  int32_t max_velocity = 5;
+  float slowdown_p = 0.45f;
+};
+
+// A probability as a fraction of 2^32, saturating at p = 1: a uniform 32-bit
+// draw below it is an event of probability p.
+inline uint32_t probabilityThreshold(float p) {
+  const double scaled = double(p) * 0x1p32;
+  if (scaled <= 0) return 0;
+  if (scaled >= std::numeric_limits<uint32_t>::max()) {
+    return std::numeric_limits<uint32_t>::max();
+  }
+  return uint32_t(scaled);
+}
+
+class NaSchRoad {
+ public:
+  // `positions` must be strictly increasing cells of the ring, and every
+  // velocity in [0, max_velocity].
+  NaSchRoad(const NaSchParams& params,
+            std::vector<int32_t> positions,
+            std::vector<int32_t> velocities)
+      : params_(params) {
+    assert(positions.size() == velocities.size());
+    assert(!positions.empty());
+    assert(int64_t(positions.size()) <= params.num_cells);
+    pos_[0] = std::move(positions);
+    vel_[0] = std::move(velocities);
+    pos_[1].resize(pos_[0].size());
+    vel_[1].resize(vel_[0].size());
+  }
+
+  // `num_vehicles` vehicles spread as evenly as possible around the ring.
+  static NaSchRoad evenlySpaced(const NaSchParams& params,
+                                size_t num_vehicles,
+                                int32_t velocity = 0) {
+    std::vector<int32_t> positions(num_vehicles);
+    for (size_t i = 0; i < num_vehicles; ++i) {
+      positions[i] = int64_t(i) * params.num_cells / int64_t(num_vehicles);
+    }
+    return NaSchRoad(params,
+                     std::move(positions),
+                     std::vector<int32_t>(num_vehicles, velocity));
+  }
+
+  // A road with new parameters and `num_vehicles` vehicles, started from
+  // another's state on the same number of cells, so that it needs less
+  // warm-up than an evenly spaced start. Fewer vehicles keeps an evenly spread
+  // subset of them; more adds stopped vehicles spread over the gaps, in
+  // proportion to their length.
+  static NaSchRoad warmStarted(const NaSchRoad& previous,
+                               const NaSchParams& params,
+                               size_t num_vehicles) {
+    assert(previous.numCells() == params.num_cells);
+    assert(int64_t(num_vehicles) <= params.num_cells);
+    const auto pos = previous.positions();
+    const auto vel = previous.velocities();
+    const size_t m = pos.size();
+    std::vector<std::pair<int32_t, int32_t>> vehicles;
+    vehicles.reserve(num_vehicles);
+    if (num_vehicles <= m) {
+      for (size_t i = 0; i < num_vehicles; ++i) {
+        const size_t j = i * m / num_vehicles;
+        vehicles.emplace_back(pos[j], std::min(vel[j], params.max_velocity));
+      }
+    } else {
+      // Split the extra vehicles over the gaps by largest remainder.
+      const int64_t extra = num_vehicles - m;
+      const int64_t empty = params.num_cells - int64_t(m);
+      std::vector<int64_t> counts(m);
+      std::vector<std::pair<int64_t, size_t>> remainders(m);
+      int64_t placed = 0;
+      for (size_t i = 0; i < m; ++i) {
+        const int64_t gap = previous.gapAhead(i);
+        counts[i] = extra * gap / empty;
+        remainders[i] = {extra * gap % empty, i};
+        placed += counts[i];
+      }
+      std::sort(remainders.rbegin(), remainders.rend());
+      for (const auto& [remainder, i] : remainders) {
+        if (placed == extra) break;
+        if (counts[i] < previous.gapAhead(i)) {
+          ++counts[i];
+          ++placed;
+        }
+      }
+      for (size_t i = 0; i < m; ++i) {
+        vehicles.emplace_back(pos[i], std::min(vel[i], params.max_velocity));
+        // k vehicles spaced evenly over the gap's g cells.
+        const int64_t k = counts[i], g = previous.gapAhead(i);
+        for (int64_t j = 1; j <= k; ++j) {
+          vehicles.emplace_back((pos[i] + j * (g + 1) / (k + 1)) %
+                                    params.num_cells,
+                                0);
+        }
+      }
+    }
+    std::sort(vehicles.begin(), vehicles.end());
+    std::vector<int32_t> positions, velocities;
+    for (const auto& [x, v] : vehicles) {
+      positions.push_back(x);
+      velocities.push_back(v);
+    }
+    return NaSchRoad(params, std::move(positions), std::move(velocities));
+  }
+
+  // Advances every vehicle by one time step, drawing the random slowdowns
+  // from `gen`.
+  template <typename URBG>
+  void step(URBG& gen) {
+    const int32_t* pos = pos_[cur_].data();
+    const int32_t* vel = vel_[cur_].data();
+    int32_t* next_pos = pos_[1 - cur_].data();
+    int32_t* next_vel = vel_[1 - cur_].data();
+    const int32_t n = numVehicles();
+    const int32_t cells = params_.num_cells;
+
+    int64_t distance = 0;
+    for (int32_t i = 0; i < n; ++i) {
+      const int32_t ahead = i + 1 == n ? pos[0] : pos[i + 1];
+      int32_t gap = ahead - pos[i] - 1;
+      if (gap < 0) gap += cells;
+
+      int32_t v = std::min(vel[i] + 1, params_.max_velocity);
+      v = std::min(v, gap);
+      if (v > 0 && absl::Uniform<float>(gen, 0, 1) < params_.slowdown_p) --v;
+
+      int32_t x = pos[i] + v;
+      if (x >= cells) x -= cells;
+      next_pos[i] = x;
+      next_vel[i] = v;
+      distance += v;
+    }
+    cur_ = 1 - cur_;
+    last_distance_ = distance;
+  }
+
+  // Same as step(), kLanes vehicles at a time. `gen` must be a full-range
+  // generator of at least 32 bits, such as absl::BitGen or PhiloxStream; each
+  // vehicle uses its low 32 bits, slowing down when they fall below
+  // slowdown_p * 2^32. Generators with a fill(std::span<uint32_t>) method,
+  // like PhiloxStream, fill the whole step's draws at once.
+  template <typename URBG>
+  void stepVectorized(URBG& gen) {
+    static_assert(URBG::min() == 0 && (URBG::max() & 0xFFFFFFFF) == 0xFFFFFFFF,
+                  "stepVectorized() needs 32 uniform bits per draw");
+    const int32_t* pos = pos_[cur_].data();
+    const int32_t* vel = vel_[cur_].data();
+    int32_t* next_pos = pos_[1 - cur_].data();
+    int32_t* next_vel = vel_[1 - cur_].data();
+    const int32_t n = numVehicles();
+    const int32_t cells = params_.num_cells;
+    const int32_t vmax = params_.max_velocity;
+
+    random_.resize(n);
+    if constexpr (requires { gen.fill(std::span<uint32_t>(random_)); }) {
+      gen.fill(std::span<uint32_t>(random_));
+    } else {
+      for (uint32_t& bits : random_) bits = uint32_t(gen());
+    }
+    const uint32_t threshold = probabilityThreshold(params_.slowdown_p);
+
+    // Each lane's velocities add up to at most its vehicles' gaps, and all
+    // gaps add up to cells - n, so the lane sums cannot overflow.
+    Lanes distance = {};
+    int32_t i = 0;
+    // The vehicles ahead are loaded from pos + i + 1, so the last vehicle,
+    // whose leader is pos[0], is always left to the scalar loop.
+    for (; i + kLanes < n; i += kLanes) {
+      const Lanes x = load(pos + i);
+      Lanes gap = load(pos + i + 1) - x - 1;
+      gap += cells & (gap < 0);
+      Lanes v = min(min(load(vel + i) + 1, vmax + Lanes{}), gap);
+      // Comparisons yield -1 in lanes where they hold.
+      v += (loadBits(random_.data() + i) < threshold) & (v > 0);
+      Lanes next = x + v;
+      next -= cells & (next >= cells);
+      store(next_pos + i, next);
+      store(next_vel + i, v);
+      distance += v;
+    }
+    int64_t total = 0;
+    for (int lane = 0; lane < kLanes; ++lane) total += distance[lane];
+    for (; i < n; ++i) {
+      const int32_t ahead = i + 1 == n ? pos[0] : pos[i + 1];
+      int32_t gap = ahead - pos[i] - 1;
+      if (gap < 0) gap += cells;
+      int32_t v = std::min(std::min(vel[i] + 1, vmax), gap);
+      if (v > 0 && random_[i] < threshold) --v;
+      int32_t x = pos[i] + v;
+      if (x >= cells) x -= cells;
+      next_pos[i] = x;
+      next_vel[i] = v;
+      total += v;
+    }
+    cur_ = 1 - cur_;
+    last_distance_ = total;
+  }
+
+  int32_t numVehicles() const { return pos_[cur_].size(); }
+  // Empty cells between vehicle i and the one ahead of it.
+  int32_t gapAhead(int32_t i) const {
+    const auto pos = positions();
+    const int32_t ahead = i + 1 == numVehicles() ? pos[0] : pos[i + 1];
+    const int32_t gap = ahead - pos[i] - 1;
+    return gap < 0 ? gap + params_.num_cells : gap;
+  }
+  int32_t numCells() const { return params_.num_cells; }
+  const NaSchParams& params() const { return params_; }
+
+  // Current state, for rendering or statistics. Valid until the next step.
+  std::span<const int32_t> positions() const { return pos_[cur_]; }
+  std::span<const int32_t> velocities() const { return vel_[cur_]; }
+
+  // Total cells moved by all vehicles in the last step: the flow past a point,
+  // summed over every point of the ring.
+  int64_t lastStepDistance() const { return last_distance_; }
+
+ private:
+  // 128-bit vectors: one SSE2 or NEON register.
+  static constexpr int kLanes = 4;
+  using Lanes = int32_t __attribute__((vector_size(4 * kLanes)));
+  using BitLanes = uint32_t __attribute__((vector_size(4 * kLanes)));
+
+  static Lanes load(const int32_t* p) {
+    Lanes v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  static BitLanes loadBits(const uint32_t* p) {
+    BitLanes v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  static void store(int32_t* p, Lanes v) { std::memcpy(p, &v, sizeof(v)); }
+  static Lanes min(Lanes a, Lanes b) { return b ^ ((a ^ b) & (a < b)); }
+
+  NaSchParams params_;
+  std::vector<int32_t> pos_[2];
+  std::vector<int32_t> vel_[2];
+  int cur_ = 0;
+  int64_t last_distance_ = 0;
+  std::vector<uint32_t> random_;  // stepVectorized() draws, one per vehicle.
+};
+
+#endif  // MONTECARLO_NASCH_H_
@@ -0,0 +1,63 @@
+// Run in opt mode for accurate timings, with:
+// bazel run --compilation_mode=opt montecarlo:nasch_bench
+//
+// Compares the scalar and vectorized NaSch kernels in cell-updates/s, over
+// road lengths and densities, with both random generators.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+
+#include "absl/random/random.h"
+#include "nasch.h"
+#include "philox.h"
+#include "systems/instrumentation.h"
+
+namespace {
+
+enum Kernel { kScalar, kVectorized };
+
+// Args: cells, density in percent.
+template <Kernel kKernel, typename URBG>
+void BM_NaSchStep(benchmark::State& state) {
+  const NaSchParams params{.num_cells = int32_t(state.range(0))};
+  auto road = NaSchRoad::evenlySpaced(
+      params, int64_t(params.num_cells) * state.range(1) / 100);
+  URBG gen(42, 0, 0);
+  BenchmarkCounters counters(state);
+  for (auto _ : state) {
+    if constexpr (kKernel == kScalar) {
+      road.step(gen);
+    } else {
+      road.stepVectorized(gen);
+    }
+    benchmark::DoNotOptimize(road.lastStepDistance());
+  }
+  counters.stop();
+  state.counters["cell-updates/s"] = benchmark::Counter(
+      double(state.iterations()) * params.num_cells,
+      benchmark::Counter::kIsRate);
+  state.counters["vehicles"] = road.numVehicles();
+}
+
+// absl::BitGen with the same constructor shape as PhiloxStream.
+struct BitGen : absl::BitGen {
+  BitGen(uint64_t seed, uint32_t, uint32_t)
+      : absl::BitGen(std::seed_seq{seed}) {}
+};
+
+void roadSizes(benchmark::internal::Benchmark* b) {
+  for (int64_t cells : {1 << 12, 1 << 20}) {
+    for (int64_t density : {10, 50, 90}) b->Args({cells, density});
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BM_NaSchStep<kScalar, BitGen>)->Apply(roadSizes);
+BENCHMARK(BM_NaSchStep<kVectorized, BitGen>)->Apply(roadSizes);
+BENCHMARK(BM_NaSchStep<kScalar, PhiloxStream>)->Apply(roadSizes);
+BENCHMARK(BM_NaSchStep<kVectorized, PhiloxStream>)->Apply(roadSizes);
+
+BENCHMARK_MAIN();
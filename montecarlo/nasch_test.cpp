@@ -0,0 +1,157 @@
+#include "nasch.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+
+#include "gmock/gmock.h"
+#include "philox.h"
+#include "running_stats.h"
+
+namespace {
+
+// Vehicles stay in ring order on distinct cells, with legal velocities.
+void expectValidState(const NaSchRoad& road) {
+  const auto pos = road.positions();
+  const auto vel = road.velocities();
+  int wraps = 0;
+  for (int32_t i = 0; i < road.numVehicles(); ++i) {
+    ASSERT_GE(pos[i], 0);
+    ASSERT_LT(pos[i], road.numCells());
+    ASSERT_GE(vel[i], 0);
+    ASSERT_LE(vel[i], road.params().max_velocity);
+    const int32_t ahead = pos[(i + 1) % road.numVehicles()];
+    if (ahead <= pos[i]) ++wraps;
+  }
+  // Going once around the ring passes the origin exactly once.
+  EXPECT_EQ(1, wraps);
+}
+
+}  // namespace
+
+TEST(NaSchTest, FreeFlowReachesMaxVelocity) {
+  auto road = NaSchRoad::evenlySpaced(
+      {.num_cells = 100, .max_velocity = 5, .slowdown_p = 0}, 10);
+  absl::BitGen gen;
+  for (int t = 0; t < 5; ++t) road.step(gen);
+  for (int32_t v : road.velocities()) EXPECT_EQ(5, v);
+  EXPECT_EQ(50, road.lastStepDistance());
+}
+
+TEST(NaSchTest, VehiclesNeverCollide) {
+  // Dense enough for jams, including vehicles on adjacent cells.
+  auto road = NaSchRoad::evenlySpaced(
+      {.num_cells = 200, .max_velocity = 5, .slowdown_p = 0.45f}, 120, 3);
+  absl::BitGen gen;
+  for (int t = 0; t < 1000; ++t) {
+    road.step(gen);
+    expectValidState(road);
+  }
+}
+
+TEST(NaSchTest, GapLimitsVelocity) {
+  // Two vehicles with one empty cell between them, both ways round.
+  NaSchRoad road(
+      {.num_cells = 4, .max_velocity = 5, .slowdown_p = 0}, {0, 2}, {0, 0});
+  absl::BitGen gen;
+  road.step(gen);
+  EXPECT_THAT(road.velocities(), testing::ElementsAre(1, 1));
+  EXPECT_THAT(road.positions(), testing::ElementsAre(1, 3));
+  road.step(gen);
+  EXPECT_THAT(road.positions(), testing::ElementsAre(2, 0));
+  expectValidState(road);
+}
+
+TEST(NaSchTest, FullRoadIsStuck) {
+  std::vector<int32_t> cells(8);
+  std::iota(cells.begin(), cells.end(), 0);
+  NaSchRoad road({.num_cells = 8, .max_velocity = 5, .slowdown_p = 0.5f},
+                 cells,
+                 std::vector<int32_t>(8, 0));
+  absl::BitGen gen;
+  road.step(gen);
+  EXPECT_EQ(0, road.lastStepDistance());
+  EXPECT_THAT(road.positions(), testing::ElementsAreArray(cells));
+}
+
+TEST(NaSchTest, VectorizedStepMatchesScalarWithoutSlowdown) {
+  // With p = 0 the model is deterministic, so both kernels must agree
+  // exactly, at every vehicle count around the vector width.
+  for (size_t n = 1; n <= 13; ++n) {
+    const NaSchParams params{
+        .num_cells = 40, .max_velocity = 5, .slowdown_p = 0};
+    auto scalar = NaSchRoad::evenlySpaced(params, n, 2);
+    auto vectorized = NaSchRoad::evenlySpaced(params, n, 2);
+    absl::BitGen gen;
+    for (int t = 0; t < 50; ++t) {
+      scalar.step(gen);
+      vectorized.stepVectorized(gen);
+      ASSERT_THAT(vectorized.positions(),
+                  testing::ElementsAreArray(scalar.positions()));
+      ASSERT_THAT(vectorized.velocities(),
+                  testing::ElementsAreArray(scalar.velocities()));
+      ASSERT_EQ(scalar.lastStepDistance(), vectorized.lastStepDistance());
+    }
+  }
+}
+
+TEST(NaSchTest, VectorizedStepVehiclesNeverCollide) {
+  auto road = NaSchRoad::evenlySpaced(
+      {.num_cells = 200, .max_velocity = 5, .slowdown_p = 0.45f}, 123, 3);
+  PhiloxStream gen(7, 0, 0);
+  for (int t = 0; t < 1000; ++t) {
+    road.stepVectorized(gen);
+    expectValidState(road);
+  }
+}
+
+TEST(NaSchTest, VectorizedStepMatchesScalarFlow) {
+  // Mean flow after warm-up, over independent runs of each kernel, near the
+  // critical density where it is most sensitive to the slowdown rule.
+  const NaSchParams params{.num_cells = 1000, .slowdown_p = 0.3f};
+  RunningStats scalar, vectorized;
+  for (uint32_t r = 0; r < 40; ++r) {
+    auto a = NaSchRoad::evenlySpaced(params, 150);
+    auto b = NaSchRoad::evenlySpaced(params, 150);
+    PhiloxStream gen_a(1, r, 0), gen_b(2, r, 0);
+    int64_t distance_a = 0, distance_b = 0;
+    for (int t = 0; t < 600; ++t) {
+      a.step(gen_a);
+      b.stepVectorized(gen_b);
+      if (t < 200) continue;
+      distance_a += a.lastStepDistance();
+      distance_b += b.lastStepDistance();
+    }
+    scalar.add(double(distance_a) / 400 / params.num_cells);
+    vectorized.add(double(distance_b) / 400 / params.num_cells);
+  }
+  const double se = std::hypot(scalar.standardError(),
+                               vectorized.standardError());
+  EXPECT_NEAR(scalar.mean(), vectorized.mean(), 4 * se);
+}
+
+TEST(NaSchTest, WarmStartKeepsOrAddsVehicles) {
+  const NaSchParams params{.num_cells = 300, .slowdown_p = 0.3f};
+  auto road = NaSchRoad::evenlySpaced(params, 90);
+  absl::BitGen gen;
+  for (int t = 0; t < 200; ++t) road.step(gen);
+
+  NaSchParams slower = params;
+  slower.max_velocity = 2;
+  for (size_t n : {1, 45, 90, 91, 200, 300}) {
+    auto warm = NaSchRoad::warmStarted(road, slower, n);
+    ASSERT_EQ(n, warm.numVehicles());
+    // Positions are strictly increasing, and so on distinct cells.
+    EXPECT_TRUE(std::is_sorted(warm.positions().begin(),
+                               warm.positions().end(),
+                               std::less_equal<int32_t>()));
+    for (int32_t v : warm.velocities()) EXPECT_LE(v, 2);
+    for (int t = 0; t < 20; ++t) {
+      warm.step(gen);
+      expectValidState(warm);
+    }
+  }
+}
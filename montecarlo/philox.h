@@ -0,0 +1,111 @@
+#ifndef MONTECARLO_PHILOX_H_
+#define MONTECARLO_PHILOX_H_
+
+// Philox4x32-10, the counter-based generator of Salmon et al., "Parallel
+// random numbers: as easy as 1, 2, 3" (SC 2011).
+//
+// Each output block is a pure function of a 64-bit key and a 128-bit counter,
+// so any stream can be computed independently of every other: there is no
+// generator state to share, split or advance. PhiloxStream fixes the key and
+// the upper half of the counter (e.g. replication and time step) and walks
+// the lower half, which gives 2^64 blocks per stream.
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+
+using PhiloxKey = std::array<uint32_t, 2>;
+using PhiloxCounter = std::array<uint32_t, 4>;
+
+// Round multipliers, and the Weyl sequence increments of the key.
+inline constexpr uint32_t kPhiloxMul0 = 0xD2511F53, kPhiloxMul1 = 0xCD9E8D57;
+inline constexpr uint32_t kPhiloxWeyl0 = 0x9E3779B9, kPhiloxWeyl1 = 0xBB67AE85;
+
+inline PhiloxCounter philox4x32(PhiloxCounter ctr, PhiloxKey key) {
+  for (int round = 0; round < 10; ++round) {
+    const uint64_t p0 = uint64_t{kPhiloxMul0} * ctr[0];
+    const uint64_t p1 = uint64_t{kPhiloxMul1} * ctr[2];
+    ctr = {uint32_t(p1 >> 32) ^ ctr[1] ^ key[0],
+           uint32_t(p1),
+           uint32_t(p0 >> 32) ^ ctr[3] ^ key[1],
+           uint32_t(p0)};
+    key[0] += kPhiloxWeyl0;
+    key[1] += kPhiloxWeyl1;
+  }
+  return ctr;
+}
+
+// A uniform random bit generator over one Philox stream, usable with absl and
+// <random> distributions.
+class PhiloxStream {
+ public:
+  using result_type = uint32_t;
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  PhiloxStream(uint64_t seed, uint32_t stream_hi, uint32_t stream_lo)
+      : key_{uint32_t(seed), uint32_t(seed >> 32)},
+        ctr_{0, 0, stream_lo, stream_hi} {}
+
+  result_type operator()() {
+    if (next_ == 4) {
+      block_ = philox4x32(ctr_, key_);
+      if (++ctr_[0] == 0) ++ctr_[1];
+      next_ = 0;
+    }
+    return block_[next_++];
+  }
+
+  // The next out.size() outputs, as from calling operator() that many times.
+  // Whole blocks are generated four at a time, interleaved so that their
+  // rounds overlap, which is close to twice as fast.
+  void fill(std::span<uint32_t> out) {
+    size_t i = 0;
+    while (i < out.size() && next_ < 4) out[i++] = block_[next_++];
+    for (; i + 16 <= out.size(); i += 16) fourBlocks(out.data() + i);
+    for (; i < out.size(); ++i) out[i] = (*this)();
+  }
+
+ private:
+  // philox4x32 on counters ctr_ to ctr_ + 3, one lane each.
+  void fourBlocks(uint32_t* out) {
+    uint32_t c0[4], c1[4], c2[4], c3[4];
+    for (int j = 0; j < 4; ++j) {
+      c0[j] = ctr_[0] + j;
+      c1[j] = ctr_[1] + (c0[j] < ctr_[0]);
+      c2[j] = ctr_[2];
+      c3[j] = ctr_[3];
+    }
+    PhiloxKey key = key_;
+    for (int round = 0; round < 10; ++round) {
+      for (int j = 0; j < 4; ++j) {
+        const uint64_t p0 = uint64_t{kPhiloxMul0} * c0[j];
+        const uint64_t p1 = uint64_t{kPhiloxMul1} * c2[j];
+        c0[j] = uint32_t(p1 >> 32) ^ c1[j] ^ key[0];
+        c1[j] = uint32_t(p1);
+        c2[j] = uint32_t(p0 >> 32) ^ c3[j] ^ key[1];
+        c3[j] = uint32_t(p0);
+      }
+      key[0] += kPhiloxWeyl0;
+      key[1] += kPhiloxWeyl1;
+    }
+    for (int j = 0; j < 4; ++j) {
+      const uint32_t block[4] = {c0[j], c1[j], c2[j], c3[j]};
+      std::memcpy(out + 4 * j, block, sizeof(block));
+    }
+    const uint32_t lo = ctr_[0];
+    ctr_[0] += 4;
+    if (ctr_[0] < lo) ++ctr_[1];
+  }
+
+  PhiloxKey key_;
+  PhiloxCounter ctr_;
+  PhiloxCounter block_;
+  int next_ = 4;
+};
+
+#endif  // MONTECARLO_PHILOX_H_
@@ -0,0 +1,54 @@
+#include "philox.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "absl/random/random.h"
+#include "gmock/gmock.h"
+
+using ::testing::ElementsAre;
+
+TEST(PhiloxTest, KnownAnswers) {
+  // From the Random123 distribution's kat_vectors.
+  EXPECT_THAT(philox4x32({0, 0, 0, 0}, {0, 0}),
+              ElementsAre(0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8));
+  EXPECT_THAT(philox4x32({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                         {0xffffffff, 0xffffffff}),
+              ElementsAre(0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd));
+  EXPECT_THAT(philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+                         {0xa4093822, 0x299f31d0}),
+              ElementsAre(0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1));
+}
+
+TEST(PhiloxTest, StreamsAreReproducibleAndDistinct) {
+  PhiloxStream a(42, 7, 3), b(42, 7, 3), c(42, 7, 4), d(43, 7, 3);
+  for (int i = 0; i < 10; ++i) {
+    const uint32_t x = a();
+    EXPECT_EQ(x, b());
+    EXPECT_NE(x, c());
+    EXPECT_NE(x, d());
+  }
+}
+
+TEST(PhiloxTest, WorksWithAbslDistributions) {
+  PhiloxStream gen(1, 0, 0);
+  double sum = 0;
+  constexpr int kDraws = 100000;
+  for (int i = 0; i < kDraws; ++i) sum += absl::Uniform<double>(gen, 0, 1);
+  EXPECT_NEAR(0.5, sum / kDraws, 0.01);
+}
+
+TEST(PhiloxTest, FillMatchesSingleDraws) {
+  // Offsets and lengths on both sides of block and four-block boundaries.
+  for (int skip : {0, 1, 3, 4, 5}) {
+    for (size_t size : {0, 1, 15, 16, 17, 35, 64, 100}) {
+      PhiloxStream a(9, 1, 2), b(9, 1, 2);
+      for (int i = 0; i < skip; ++i) EXPECT_EQ(a(), b());
+      std::vector<uint32_t> filled(size);
+      a.fill(filled);
+      for (size_t i = 0; i < size; ++i) ASSERT_EQ(b(), filled[i]);
+      EXPECT_EQ(b(), a());
+    }
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef MONTECARLO_REPLICATIONS_H_
+#define MONTECARLO_REPLICATIONS_H_
+
+// Independent replications of the Nagel-Schreckenberg model, run in parallel.
+//
+// Every random draw comes from a Philox stream keyed by (seed, replication,
+// step), so a replication's trajectory doesn't depend on which thread runs it
+// or what ran before. Per-replication results are then accumulated in
+// replication order, which makes the estimates bit-identical for any number
+// of threads.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "nasch.h"
+#include "philox.h"
+#include "running_stats.h"
+#include "systems/work_stealing_pool.h"
+
+struct ReplicationConfig {
+  NaSchParams params;
+  size_t num_vehicles = 100;
+  // Steps run before measuring, to forget the evenly spaced start.
+  int warmup_steps = 1000;
+  int measure_steps = 1000;
+  // Cells [0, detector_cells) act as a detector for the local density.
+  int32_t detector_cells = 100;
+  uint64_t seed = 0;
+};
+
+// Time averages over the measured steps of one replication.
+struct ReplicationResult {
+  // Vehicles passing a point per step, averaged over all points.
+  double flow;
+  // Fraction of detector cells occupied.
+  double density;
+  // Mean velocity over all vehicles.
+  double velocity;
+};
+
+struct FlowEstimate {
+  RunningStats flow;
+  RunningStats density;
+  RunningStats velocity;
+};
+
+inline ReplicationResult runReplication(const ReplicationConfig& config,
+                                        uint32_t replication) {
+  auto road = NaSchRoad::evenlySpaced(config.params, config.num_vehicles);
+  uint32_t t = 0;
+  for (; t < uint32_t(config.warmup_steps); ++t) {
+    PhiloxStream gen(config.seed, replication, t);
+    road.step(gen);
+  }
+
+  int64_t distance = 0;
+  int64_t occupied = 0;
+  for (int s = 0; s < config.measure_steps; ++s, ++t) {
+    PhiloxStream gen(config.seed, replication, t);
+    road.step(gen);
+    distance += road.lastStepDistance();
+    for (int32_t x : road.positions()) occupied += x < config.detector_cells;
+  }
+  const double steps = config.measure_steps;
+  return {
+      .flow = distance / (steps * road.numCells()),
+      .density = occupied / (steps * config.detector_cells),
+      .velocity = distance / (steps * road.numVehicles()),
+  };
+}
+
+inline FlowEstimate runReplications(const ReplicationConfig& config,
+                                    size_t num_replications,
+                                    WorkStealingPool& pool) {
+  std::vector<ReplicationResult> results(num_replications);
+  pool.parallelFor(num_replications, [&](size_t r, size_t) {
+    results[r] = runReplication(config, r);
+  });
+
+  FlowEstimate estimate;
+  for (const ReplicationResult& r : results) {
+    estimate.flow.add(r.flow);
+    estimate.density.add(r.density);
+    estimate.velocity.add(r.velocity);
+  }
+  return estimate;
+}
+
+#endif  // MONTECARLO_REPLICATIONS_H_
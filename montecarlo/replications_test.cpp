@@ -0,0 +1,67 @@
+#include "replications.h"
+
+#include <gtest/gtest.h>
+
+#include "gmock/gmock.h"
+
+namespace {
+
+ReplicationConfig smallConfig() {
+  return {.params = {.num_cells = 500, .max_velocity = 5, .slowdown_p = 0.3f},
+          .num_vehicles = 75,
+          .warmup_steps = 100,
+          .measure_steps = 200,
+          .detector_cells = 50,
+          .seed = 12345};
+}
+
+}  // namespace
+
+TEST(RunningStatsTest, MergeMatchesSequential) {
+  RunningStats all, left, right;
+  for (int i = 0; i < 100; ++i) {
+    const double x = std::sin(i) * 10 + i * 0.1;
+    all.add(x);
+    (i < 37 ? left : right).add(x);
+  }
+  left.merge(right);
+  EXPECT_EQ(all.count(), left.count());
+  EXPECT_NEAR(all.mean(), left.mean(), 1e-12);
+  EXPECT_NEAR(all.variance(), left.variance(), 1e-10);
+}
+
+TEST(ReplicationsTest, BitIdenticalAcrossThreadCounts) {
+  const ReplicationConfig config = smallConfig();
+  WorkStealingPool serial(1);
+  const FlowEstimate expected = runReplications(config, 40, serial);
+  for (size_t num_threads : {2, 3, 8}) {
+    WorkStealingPool pool(num_threads);
+    const FlowEstimate actual = runReplications(config, 40, pool);
+    EXPECT_EQ(expected.flow.mean(), actual.flow.mean());
+    EXPECT_EQ(expected.flow.variance(), actual.flow.variance());
+    EXPECT_EQ(expected.density.mean(), actual.density.mean());
+    EXPECT_EQ(expected.velocity.mean(), actual.velocity.mean());
+  }
+}
+
+TEST(ReplicationsTest, ReplicationsAreIndependentStreams) {
+  const ReplicationConfig config = smallConfig();
+  const ReplicationResult a = runReplication(config, 0);
+  EXPECT_EQ(a.flow, runReplication(config, 0).flow);
+  EXPECT_NE(a.flow, runReplication(config, 1).flow);
+}
+
+TEST(ReplicationsTest, EstimatesAreConsistent) {
+  const ReplicationConfig config = smallConfig();
+  WorkStealingPool pool(2);
+  const FlowEstimate estimate = runReplications(config, 50, pool);
+  // Flow is density times mean velocity on the whole ring.
+  EXPECT_NEAR(estimate.flow.mean(),
+              estimate.velocity.mean() * config.num_vehicles /
+                  config.params.num_cells,
+              1e-12);
+  // The detector sees the global density on average.
+  EXPECT_NEAR(0.15, estimate.density.mean(), 3 * estimate.density.halfWidth());
+  EXPECT_GT(estimate.flow.halfWidth(), 0);
+  EXPECT_LT(estimate.flow.halfWidth(), 0.1 * estimate.flow.mean());
+}
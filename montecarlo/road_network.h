@@ -0,0 +1,379 @@
+#ifndef MONTECARLO_ROAD_NETWORK_H_
+#define MONTECARLO_ROAD_NETWORK_H_
+
+// Nagel-Schreckenberg traffic on a network of multi-lane road segments,
+// simulated in parallel with one domain per segment.
+//
+// Segments are directed, each with its own length, lanes, speed limit and
+// slowdown probability, and join at junction nodes. A vehicle picks the
+// segment it will take after the next junction when it enters a segment, so
+// near the end of a segment it can see into the first cells of that one.
+//
+// The network is closed: every node needs an outgoing segment, and vehicles
+// are only ever moved, never created or removed.
+//
+// State is cell-based (a velocity per cell, or kEmpty), double-buffered per
+// segment for movement. Each step runs three phases, each a parallelFor over
+// segments:
+//   1. Lane changes, within each segment, using the symmetric rules of
+//      Rickert et al., "Two lane traffic simulations using cellular automata"
+//      (1996). Even steps only change to the next lane up, odd steps only
+//      down, so two vehicles never claim the same cell.
+//   2. Movement. A segment only writes its own cells; a vehicle crossing the
+//      end goes to the segment's outbox instead. Only the front vehicle of a
+//      lane can cross, since its followers stop short of it.
+//   3. Hand-off. Each segment takes the vehicles crossing into it from its
+//      upstream segments' outboxes, in an order of priority that rotates every
+//      step. If vehicles merging from different lanes or segments want the
+//      same cells, later ones stop behind earlier ones, and a vehicle with no
+//      room left waits on the last cell of its old segment (which its
+//      followers cannot have reached).
+// Every random draw comes from a Philox stream keyed by (seed, step, segment,
+// phase), so results do not depend on the number of threads.
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/random/random.h"
+#include "nasch.h"
+#include "philox.h"
+#include "systems/work_stealing_pool.h"
+
+struct SegmentParams {
+  int32_t length = 100;  // Cells per lane.
+  int32_t num_lanes = 1;
+  int32_t max_velocity = 5;
+  float slowdown_p = 0.45f;
+  // Probability that a vehicle changes lanes when it wants to and it is safe.
+  float lane_change_p = 1.0f;
+};
+
+class RoadNetwork {
+ public:
+  using NodeId = int32_t;
+  using SegmentId = int32_t;
+
+  static constexpr int8_t kEmpty = -1;
+
+  explicit RoadNetwork(uint64_t seed = 0)
+      : seed_(seed), setup_gen_(seed, ~0u, 0) {}
+
+  // A rows x cols grid of junctions on a torus, joined by a segment in each
+  // direction between neighbours, so every junction has four ways in and out.
+  static RoadNetwork torusGrid(int32_t rows,
+                               int32_t cols,
+                               const SegmentParams& params,
+                               uint64_t seed = 0) {
+    RoadNetwork network(seed);
+    for (int32_t i = 0; i < rows * cols; ++i) network.addNode();
+    for (int32_t r = 0; r < rows; ++r) {
+      for (int32_t c = 0; c < cols; ++c) {
+        const NodeId node = r * cols + c;
+        const NodeId east = r * cols + (c + 1) % cols;
+        const NodeId south = (r + 1) % rows * cols + c;
+        network.addSegment(node, east, params);
+        network.addSegment(east, node, params);
+        network.addSegment(node, south, params);
+        network.addSegment(south, node, params);
+      }
+    }
+    return network;
+  }
+
+  NodeId addNode() {
+    out_.emplace_back();
+    in_.emplace_back();
+    return out_.size() - 1;
+  }
+
+  SegmentId addSegment(NodeId from, NodeId to, const SegmentParams& params) {
+    assert(params.length > 0 && params.num_lanes > 0);
+    assert(params.max_velocity >= 0 && params.max_velocity <= 127);
+    const SegmentId id = segments_.size();
+    Segment& s = segments_.emplace_back();
+    s.params = params;
+    s.from = from;
+    s.to = to;
+    const size_t cells = size_t(params.length) * params.num_lanes;
+    for (int b = 0; b < 2; ++b) {
+      s.vel[b].assign(cells, kEmpty);
+      s.route[b].resize(cells);
+    }
+    s.entry_limit.resize(params.num_lanes);
+    out_[from].push_back(id);
+    in_[to].push_back(id);
+    return id;
+  }
+
+  // Places a vehicle on an empty cell, choosing its route at random.
+  void addVehicle(SegmentId segment,
+                  int32_t lane,
+                  int32_t cell,
+                  int32_t velocity = 0) {
+    Segment& s = segments_[segment];
+    const size_t i = s.index(lane, cell);
+    assert(s.vel[s.cur][i] == kEmpty);
+    s.vel[s.cur][i] = velocity;
+    s.route[s.cur][i] = chooseRoute(s.to, setup_gen_);
+  }
+
+  // Fills each cell of the network with a stopped vehicle with probability
+  // `density`.
+  void populate(double density) {
+    for (SegmentId id = 0; id < numSegments(); ++id) {
+      const SegmentParams& params = segments_[id].params;
+      for (int32_t lane = 0; lane < params.num_lanes; ++lane) {
+        for (int32_t cell = 0; cell < params.length; ++cell) {
+          if (absl::Bernoulli(setup_gen_, density)) addVehicle(id, lane, cell);
+        }
+      }
+    }
+  }
+
+  void step(WorkStealingPool& pool) {
+    pool.parallelFor(numSegments(),
+                     [this](size_t s, size_t) { changeLanes(s); });
+    pool.parallelFor(numSegments(), [this](size_t s, size_t) { move(s); });
+    pool.parallelFor(numSegments(), [this](size_t s, size_t) { handOff(s); });
+    last_distance_ = 0;
+    for (Segment& s : segments_) {
+      s.cur = 1 - s.cur;
+      last_distance_ += s.distance;
+    }
+    ++t_;
+  }
+
+  int32_t numNodes() const { return out_.size(); }
+  int32_t numSegments() const { return segments_.size(); }
+  const SegmentParams& params(SegmentId segment) const {
+    return segments_[segment].params;
+  }
+  NodeId from(SegmentId segment) const { return segments_[segment].from; }
+  NodeId to(SegmentId segment) const { return segments_[segment].to; }
+
+  // Velocity of the vehicle on a cell, or kEmpty.
+  int32_t velocityAt(SegmentId segment, int32_t lane, int32_t cell) const {
+    const Segment& s = segments_[segment];
+    return s.vel[s.cur][s.index(lane, cell)];
+  }
+
+  int64_t numVehicles() const {
+    int64_t n = 0;
+    for (const Segment& s : segments_) {
+      n += s.vel[s.cur].size() -
+           std::count(s.vel[s.cur].begin(), s.vel[s.cur].end(), kEmpty);
+    }
+    return n;
+  }
+
+  // Total cells moved by all vehicles in the last step.
+  int64_t lastStepDistance() const { return last_distance_; }
+
+ private:
+  // A vehicle leaving a segment in phase 2, placed by its next segment in
+  // phase 3.
+  struct Crossing {
+    int32_t lane;
+    int32_t cell;  // Where it was.
+    SegmentId next;
+    int32_t next_lane;
+    int32_t next_cell;  // Where it wants to be.
+  };
+
+  struct Segment {
+    size_t index(int32_t lane, int32_t cell) const {
+      return size_t(lane) * params.length + cell;
+    }
+
+    SegmentParams params;
+    NodeId from, to;
+    // Lane-major cells, double-buffered: vel[cur] and route[cur] are current.
+    // route is the segment a vehicle takes next, where vel is not kEmpty.
+    std::vector<int8_t> vel[2];
+    std::vector<SegmentId> route[2];
+    int cur = 0;
+    std::vector<Crossing> outbox;
+    std::vector<std::pair<size_t, size_t>> lane_changes;  // Phase 1 scratch.
+    std::vector<int32_t> entry_limit;  // Phase 3 scratch, per lane.
+    int64_t distance = 0;
+  };
+
+  enum Phase : uint32_t { kLaneChange, kMove, kHandOff, kNumPhases };
+
+  PhiloxStream stream(SegmentId s, Phase phase) const {
+    return PhiloxStream(seed_, t_, uint32_t(s) * kNumPhases + phase);
+  }
+
+  template <typename URBG>
+  SegmentId chooseRoute(NodeId node, URBG& gen) const {
+    const std::vector<SegmentId>& out = out_[node];
+    assert(!out.empty() && "Every node needs an outgoing segment");
+    if (out.size() == 1) return out[0];
+    return out[absl::Uniform<size_t>(gen, 0, out.size())];
+  }
+
+  // Empty cells in a lane after `cell`, counting up to `limit`. Cells past the
+  // end of the segment count as empty.
+  static int32_t freeAhead(const int8_t* lane,
+                           int32_t length,
+                           int32_t cell,
+                           int32_t limit) {
+    int32_t n = 0;
+    for (int32_t x = cell + 1; n < limit; ++x, ++n) {
+      if (x < length && lane[x] != kEmpty) break;
+    }
+    return n;
+  }
+
+  // Whether there are no vehicles in cells [cell - n, cell] of a lane.
+  static bool clearBehind(const int8_t* lane, int32_t cell, int32_t n) {
+    for (int32_t x = std::max(0, cell - n); x <= cell; ++x) {
+      if (lane[x] != kEmpty) return false;
+    }
+    return true;
+  }
+
+  void changeLanes(SegmentId id) {
+    Segment& s = segments_[id];
+    const SegmentParams& p = s.params;
+    if (p.num_lanes == 1) return;
+    int8_t* vel = s.vel[s.cur].data();
+    SegmentId* route = s.route[s.cur].data();
+    const uint32_t lane_change = probabilityThreshold(p.lane_change_p);
+    PhiloxStream gen = stream(id, kLaneChange);
+
+    // Decide every change on the old state, then apply them in place: each
+    // moves a vehicle to a cell that was empty and that no one else wants.
+    s.lane_changes.clear();
+    const int dir = t_ % 2 == 0 ? 1 : -1;
+    for (int32_t lane = 0; lane < p.num_lanes; ++lane) {
+      const int32_t other = lane + dir;
+      if (other < 0 || other >= p.num_lanes) continue;
+      const int8_t* here = vel + s.index(lane, 0);
+      const int8_t* there = vel + s.index(other, 0);
+      for (int32_t x = 0; x < p.length; ++x) {
+        if (here[x] == kEmpty) continue;
+        // Change if blocked here, better off there, and not cutting off
+        // anyone behind.
+        const int32_t want = std::min(here[x] + 1, p.max_velocity);
+        const int32_t gap = freeAhead(here, p.length, x, want);
+        if (gap < want && freeAhead(there, p.length, x, want) > gap &&
+            clearBehind(there, x, p.max_velocity) &&
+            (p.lane_change_p >= 1 || gen() < lane_change)) {
+          s.lane_changes.emplace_back(s.index(lane, x), s.index(other, x));
+        }
+      }
+    }
+    for (const auto& [from, to] : s.lane_changes) {
+      vel[to] = vel[from];
+      route[to] = route[from];
+      vel[from] = kEmpty;
+    }
+  }
+
+  void move(SegmentId id) {
+    Segment& s = segments_[id];
+    const int32_t length = s.params.length;
+    const int32_t vmax = s.params.max_velocity;
+    const uint32_t slowdown = probabilityThreshold(s.params.slowdown_p);
+    std::fill(s.vel[1 - s.cur].begin(), s.vel[1 - s.cur].end(), kEmpty);
+    s.outbox.clear();
+    PhiloxStream gen = stream(id, kMove);
+
+    int64_t distance = 0;
+    for (int32_t lane = 0; lane < s.params.num_lanes; ++lane) {
+      const size_t offset = s.index(lane, 0);
+      const int8_t* vel = s.vel[s.cur].data() + offset;
+      const SegmentId* route = s.route[s.cur].data() + offset;
+      int8_t* next_vel = s.vel[1 - s.cur].data() + offset;
+      SegmentId* next_route = s.route[1 - s.cur].data() + offset;
+      int32_t ahead = -1;  // Cell of the vehicle ahead, if any.
+      for (int32_t x = length; x-- > 0;) {
+        if (vel[x] == kEmpty) continue;
+        int32_t v = std::min(vel[x] + 1, vmax);
+        int32_t gap;
+        if (ahead >= 0) {
+          gap = ahead - x - 1;
+        } else {
+          const Segment& next = segments_[route[x]];
+          const int32_t next_lane = std::min(lane, next.params.num_lanes - 1);
+          gap = length - 1 - x + entryGap(next, next_lane, v);
+        }
+        v = std::min(v, gap);
+        if (v > 0 && gen() < slowdown) --v;
+        ahead = x;
+
+        if (x + v < length) {
+          next_vel[x + v] = v;
+          next_route[x + v] = route[x];
+          distance += v;
+        } else {
+          const Segment& next = segments_[route[x]];
+          s.outbox.push_back({
+              .lane = lane,
+              .cell = x,
+              .next = route[x],
+              .next_lane = std::min(lane, next.params.num_lanes - 1),
+              .next_cell = x + v - length,
+          });
+        }
+      }
+    }
+    s.distance = distance;
+  }
+
+  // Empty cells at the start of a lane, up to `limit` and at most the whole
+  // lane, so that no vehicle crosses two junctions in one step.
+  int32_t entryGap(const Segment& s, int32_t lane, int32_t limit) const {
+    const int8_t* cells = s.vel[s.cur].data() + s.index(lane, 0);
+    limit = std::min(limit, s.params.length);
+    int32_t n = 0;
+    while (n < limit && cells[n] == kEmpty) ++n;
+    return n;
+  }
+
+  void handOff(SegmentId id) {
+    Segment& s = segments_[id];
+    std::fill(s.entry_limit.begin(), s.entry_limit.end(), s.params.length);
+    PhiloxStream gen = stream(id, kHandOff);
+    const std::vector<SegmentId>& in = in_[s.from];
+    for (size_t k = 0; k < in.size(); ++k) {
+      Segment& prev = segments_[in[(k + t_) % in.size()]];
+      for (const Crossing& c : prev.outbox) {
+        if (c.next != id) continue;
+        // Stop behind anyone who merged in first.
+        const int32_t cell =
+            std::min(c.next_cell, s.entry_limit[c.next_lane] - 1);
+        if (cell >= 0) {
+          const size_t i = s.index(c.next_lane, cell);
+          const int32_t v = prev.params.length - c.cell + cell;
+          s.vel[1 - s.cur][i] = v;
+          s.route[1 - s.cur][i] = chooseRoute(s.to, gen);
+          s.entry_limit[c.next_lane] = cell;
+          s.distance += v;
+        } else {
+          const int32_t last = prev.params.length - 1;
+          const size_t i = prev.index(c.lane, last);
+          const int32_t v = last - c.cell;
+          prev.vel[1 - prev.cur][i] = v;
+          prev.route[1 - prev.cur][i] = id;
+          s.distance += v;
+        }
+      }
+    }
+  }
+
+  uint64_t seed_;
+  PhiloxStream setup_gen_;
+  std::vector<std::vector<SegmentId>> out_;  // Indexed by NodeId.
+  std::vector<std::vector<SegmentId>> in_;
+  std::vector<Segment> segments_;
+  uint32_t t_ = 0;
+  int64_t last_distance_ = 0;
+};
+
+#endif  // MONTECARLO_ROAD_NETWORK_H_
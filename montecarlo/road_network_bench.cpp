@@ -0,0 +1,58 @@
+// Run in opt mode for accurate timings, with:
+// bazel run --compilation_mode=opt montecarlo:road_network_bench
+//
+// Steps/s of a city-scale grid network against the number of threads, at
+// about 0.8M and 2M vehicles. Compare real time across thread counts.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+
+#include "road_network.h"
+#include "systems/instrumentation.h"
+#include "systems/work_stealing_pool.h"
+
+namespace {
+
+// Args: threads, density in percent.
+void BM_GridStep(benchmark::State& state) {
+  // 64 x 64 junctions, 16384 two-lane segments of 250 cells.
+  RoadNetwork network = RoadNetwork::torusGrid(
+      64, 64, {.length = 250, .num_lanes = 2, .max_velocity = 5});
+  network.populate(state.range(1) / 100.0);
+  // Workers started after the counters are counted as they exit.
+  BenchmarkCounters counters(state);
+  counters.pause();
+  {
+    WorkStealingPool pool(state.range(0));
+    counters.resume();
+    for (auto _ : state) network.step(pool);
+    counters.pause();
+  }
+  counters.stop();
+  const int64_t vehicles = network.numVehicles();
+  state.counters["vehicles"] = vehicles;
+  state.counters["steps/s"] =
+      benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+  state.counters["vehicle-updates/s"] = benchmark::Counter(
+      double(state.iterations()) * vehicles, benchmark::Counter::kIsRate);
+}
+
+void threadCounts(benchmark::internal::Benchmark* b) {
+  const int64_t cores = std::max(1u, std::thread::hardware_concurrency());
+  for (int64_t density : {10, 25}) {
+    for (int64_t threads = 1; threads < cores; threads *= 2) {
+      b->Args({threads, density});
+    }
+    b->Args({cores, density});
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BM_GridStep)->Apply(threadCounts)->UseRealTime()->Unit(
+    benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,113 @@
+#include "road_network.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+#include "nasch.h"
+
+namespace {
+
+// Every vehicle on a cell of the network, as (segment, lane, cell, velocity).
+std::vector<std::array<int32_t, 4>> vehicles(const RoadNetwork& network) {
+  std::vector<std::array<int32_t, 4>> result;
+  for (int32_t s = 0; s < network.numSegments(); ++s) {
+    const SegmentParams& p = network.params(s);
+    for (int32_t lane = 0; lane < p.num_lanes; ++lane) {
+      for (int32_t cell = 0; cell < p.length; ++cell) {
+        const int32_t v = network.velocityAt(s, lane, cell);
+        if (v != RoadNetwork::kEmpty) result.push_back({s, lane, cell, v});
+      }
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(RoadNetworkTest, SingleLaneLoopMatchesNaSchRoad) {
+  // Without random slowdowns, a segment from a junction back to itself is
+  // the ring road.
+  const NaSchParams ring{.num_cells = 60, .max_velocity = 5, .slowdown_p = 0};
+  auto road = NaSchRoad::evenlySpaced(ring, 13, 1);
+  RoadNetwork network;
+  const auto node = network.addNode();
+  network.addSegment(node,
+                     node,
+                     {.length = ring.num_cells,
+                      .max_velocity = ring.max_velocity,
+                      .slowdown_p = 0});
+  for (int32_t x : road.positions()) network.addVehicle(0, 0, x, 1);
+
+  WorkStealingPool pool(1);
+  absl::BitGen gen;
+  for (int t = 0; t < 100; ++t) {
+    road.step(gen);
+    network.step(pool);
+    ASSERT_EQ(road.lastStepDistance(), network.lastStepDistance());
+    for (int32_t i = 0; i < road.numVehicles(); ++i) {
+      ASSERT_EQ(road.velocities()[i],
+                network.velocityAt(0, 0, road.positions()[i]));
+    }
+  }
+}
+
+TEST(RoadNetworkTest, MergesConserveVehicles) {
+  // Three lanes narrowing to one and two at every junction, with four ways
+  // in, so that hand-offs often compete for the same cells.
+  RoadNetwork network = RoadNetwork::torusGrid(
+      3, 3, {.length = 12, .num_lanes = 3, .max_velocity = 5}, 5);
+  const RoadNetwork::NodeId a = network.addNode(), b = network.addNode();
+  network.addSegment(0, a, {.length = 4, .num_lanes = 1});
+  network.addSegment(a, b, {.length = 3, .num_lanes = 2, .max_velocity = 2});
+  network.addSegment(b, 0, {.length = 7, .num_lanes = 1});
+  network.populate(0.4);
+  const int64_t n = network.numVehicles();
+  ASSERT_GT(n, 0);
+
+  WorkStealingPool pool(2);
+  int64_t distance = 0;
+  for (int t = 0; t < 500; ++t) {
+    network.step(pool);
+    distance += network.lastStepDistance();
+    ASSERT_EQ(n, network.numVehicles());
+    for (const auto& [s, lane, cell, v] : vehicles(network)) {
+      ASSERT_GE(v, 0);
+      // Vehicles keep their speed for a step after entering a slower road.
+      ASSERT_LE(v, 5);
+    }
+  }
+  // Dense closed networks can lock up, so only check that traffic moved.
+  EXPECT_GT(distance, 0);
+}
+
+TEST(RoadNetworkTest, SameResultForAnyNumberOfThreads) {
+  const SegmentParams params{.length = 30, .num_lanes = 2, .slowdown_p = 0.3f};
+  RoadNetwork a = RoadNetwork::torusGrid(4, 4, params, 11);
+  RoadNetwork b = RoadNetwork::torusGrid(4, 4, params, 11);
+  a.populate(0.25);
+  b.populate(0.25);
+  WorkStealingPool one(1), three(3);
+  for (int t = 0; t < 200; ++t) {
+    a.step(one);
+    b.step(three);
+    ASSERT_EQ(a.lastStepDistance(), b.lastStepDistance());
+  }
+  EXPECT_EQ(vehicles(a), vehicles(b));
+}
+
+TEST(RoadNetworkTest, VehiclesChangeIntoAnEmptyLane) {
+  RoadNetwork network;
+  const auto node = network.addNode();
+  network.addSegment(
+      node, node, {.length = 40, .num_lanes = 2, .slowdown_p = 0});
+  for (int32_t x = 0; x < 20; ++x) network.addVehicle(0, 0, x);
+
+  WorkStealingPool pool(1);
+  for (int t = 0; t < 20; ++t) network.step(pool);
+  int on_lane_1 = 0;
+  for (const auto& [s, lane, cell, v] : vehicles(network)) on_lane_1 += lane;
+  EXPECT_GT(on_lane_1, 0);
+  EXPECT_EQ(20, network.numVehicles());
+}
@@ -0,0 +1,51 @@
+#ifndef MONTECARLO_RUNNING_STATS_H_
+#define MONTECARLO_RUNNING_STATS_H_
+
+// Online mean and variance (Welford's algorithm), with the pairwise merge of
+// Chan, Golub and LeVeque so that partial results can be combined.
+
+#include <cmath>
+#include <cstddef>
+
+class RunningStats {
+ public:
+  void add(double x) {
+    ++n_;
+    const double delta = x - mean_;
+    mean_ += delta / n_;
+    m2_ += delta * (x - mean_);
+  }
+
+  void merge(const RunningStats& other) {
+    if (other.n_ == 0) return;
+    const double n = n_ + other.n_;
+    const double delta = other.mean_ - mean_;
+    mean_ += delta * other.n_ / n;
+    m2_ += other.m2_ + delta * delta * n_ * other.n_ / n;
+    n_ += other.n_;
+  }
+
+  size_t count() const { return n_; }
+  double mean() const { return mean_; }
+  // Sample variance.
+  double variance() const { return n_ > 1 ? m2_ / (n_ - 1) : 0; }
+  double stddev() const { return std::sqrt(variance()); }
+  double standardError() const {
+    return n_ > 0 ? stddev() / std::sqrt(n_) : 0;
+  }
+  // Half-width of the normal-approximation confidence interval for the mean,
+  // 95% by default.
+  double halfWidth(double z = 1.96) const { return z * standardError(); }
+  // Samples needed for a confidence interval of the given half-width, at the
+  // variance seen so far.
+  size_t samplesForHalfWidth(double half_width, double z = 1.96) const {
+    return std::ceil(variance() * (z / half_width) * (z / half_width));
+  }
+
+ private:
+  size_t n_ = 0;
+  double mean_ = 0;
+  double m2_ = 0;
+};
+
+#endif  // MONTECARLO_RUNNING_STATS_H_
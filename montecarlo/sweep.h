@@ -0,0 +1,192 @@
+#ifndef MONTECARLO_SWEEP_H_
+#define MONTECARLO_SWEEP_H_
+
+// Variance-reduced sweeps of the Nagel-Schreckenberg fundamental diagram:
+// mean flow at a list of (density, slowdown_p) points.
+//
+// A sample is a group of runs whose flows are averaged:
+//   kIndependent     one run.
+//   kAntithetic      two runs, the second with every random draw u replaced
+//                    by 1 - u.
+//   kQuasiMonteCarlo qmc_points runs on the same random stream. Run j XORs
+//                    every draw (one per vehicle per step) with the j-th
+//                    point of the van der Corput sequence, so in each input
+//                    the group's draws are plain van der Corput points offset
+//                    by that draw, and cover the input's range evenly. There
+//                    is no scrambling beyond this per-draw offset.
+// Samples are independent, so confidence intervals stay valid.
+//
+// With common random numbers, sample s draws the same numbers at every point,
+// which makes the differences between neighbouring points less noisy (by
+// about half above the critical density; the dynamics are too chaotic to stay
+// coupled for long).
+// With warm starts, each run walks the points in order, starting each one
+// from its state at the end of the previous point, and warms up for
+// warm_start_steps instead of warmup_steps.
+//
+// Runs use NaSchRoad::stepVectorized(), which consumes exactly one draw per
+// vehicle per step, so that the same draw always drives the same vehicle.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "nasch.h"
+#include "philox.h"
+#include "running_stats.h"
+#include "systems/work_stealing_pool.h"
+
+enum class Sampling { kIndependent, kAntithetic, kQuasiMonteCarlo };
+
+struct SweepPoint {
+  double density;
+  float slowdown_p;
+};
+
+struct SweepConfig {
+  // num_cells and max_velocity. slowdown_p comes from each point.
+  NaSchParams params;
+  std::vector<SweepPoint> points;
+  int warmup_steps = 1000;
+  int warm_start_steps = 200;
+  int measure_steps = 1000;
+  uint64_t seed = 0;
+  Sampling sampling = Sampling::kAntithetic;
+  // Runs per sample for kQuasiMonteCarlo, ideally a power of two.
+  uint32_t qmc_points = 8;
+  bool common_random_numbers = true;
+  bool warm_start = true;
+};
+
+struct SweepResult {
+  // Per point, one value per sample.
+  std::vector<RunningStats> flow;
+  // flow[k] - flow[k - 1] per sample, for k >= 1 (index 0 is empty).
+  std::vector<RunningStats> flow_difference;
+  // Vehicle updates in all runs: the cost of the sweep.
+  int64_t vehicle_steps = 0;
+};
+
+// A PhiloxStream whose outputs are XORed with a fixed mask: all ones for an
+// antithetic run, or a van der Corput point for a quasi-Monte Carlo one.
+class MaskedStream {
+ public:
+  using result_type = uint32_t;
+  static constexpr result_type min() { return PhiloxStream::min(); }
+  static constexpr result_type max() { return PhiloxStream::max(); }
+
+  MaskedStream(const PhiloxStream& stream, uint32_t mask)
+      : stream_(stream), mask_(mask) {}
+
+  result_type operator()() { return stream_() ^ mask_; }
+
+  void fill(std::span<uint32_t> out) {
+    stream_.fill(out);
+    for (uint32_t& x : out) x ^= mask_;
+  }
+
+ private:
+  PhiloxStream stream_;
+  uint32_t mask_;
+};
+
+// Point j of the base-2 van der Corput sequence, in 32-bit fixed point.
+inline uint32_t vanDerCorput(uint32_t j) {
+  j = (j << 16) | (j >> 16);
+  j = ((j & 0x00FF00FF) << 8) | ((j & 0xFF00FF00) >> 8);
+  j = ((j & 0x0F0F0F0F) << 4) | ((j & 0xF0F0F0F0) >> 4);
+  j = ((j & 0x33333333) << 2) | ((j & 0xCCCCCCCC) >> 2);
+  j = ((j & 0x55555555) << 1) | ((j & 0xAAAAAAAA) >> 1);
+  return j;
+}
+
+inline uint32_t runsPerSample(const SweepConfig& config) {
+  switch (config.sampling) {
+    case Sampling::kIndependent:
+      return 1;
+    case Sampling::kAntithetic:
+      return 2;
+    case Sampling::kQuasiMonteCarlo:
+      return config.qmc_points;
+  }
+  return 1;
+}
+
+inline size_t vehiclesAt(const SweepConfig& config, size_t k) {
+  const size_t n = config.points[k].density * config.params.num_cells;
+  return std::max<size_t>(1, n);
+}
+
+// Mean flow of run j of sample s at every point, in order.
+inline std::vector<double> runSweepChain(const SweepConfig& config,
+                                         uint32_t sample,
+                                         uint32_t j) {
+  uint32_t mask = 0;
+  if (config.sampling == Sampling::kAntithetic && j == 1) mask = ~0u;
+  if (config.sampling == Sampling::kQuasiMonteCarlo) mask = vanDerCorput(j);
+
+  std::vector<double> flows;
+  std::optional<NaSchRoad> road;
+  for (size_t k = 0; k < config.points.size(); ++k) {
+    NaSchParams params = config.params;
+    params.slowdown_p = config.points[k].slowdown_p;
+    const bool warm = config.warm_start && k > 0;
+    const size_t n = vehiclesAt(config, k);
+    road = warm ? NaSchRoad::warmStarted(*road, params, n)
+                : NaSchRoad::evenlySpaced(params, n);
+    // Independent points get unrelated keys.
+    const uint64_t key =
+        config.common_random_numbers
+            ? config.seed
+            : config.seed ^ ((k + 1) * 0x9E3779B97F4A7C15);
+    const int warmup = warm ? config.warm_start_steps : config.warmup_steps;
+    int64_t distance = 0;
+    for (int t = 0; t < warmup + config.measure_steps; ++t) {
+      MaskedStream gen(PhiloxStream(key, sample, t), mask);
+      road->stepVectorized(gen);
+      if (t >= warmup) distance += road->lastStepDistance();
+    }
+    flows.push_back(double(distance) /
+                    (double(config.measure_steps) * road->numCells()));
+  }
+  return flows;
+}
+
+inline SweepResult runSweep(const SweepConfig& config,
+                            size_t num_samples,
+                            WorkStealingPool& pool) {
+  const uint32_t runs = runsPerSample(config);
+  std::vector<std::vector<double>> flows(num_samples * runs);
+  pool.parallelFor(flows.size(), [&](size_t r, size_t) {
+    flows[r] = runSweepChain(config, r / runs, r % runs);
+  });
+
+  const size_t num_points = config.points.size();
+  SweepResult result;
+  result.flow.resize(num_points);
+  result.flow_difference.resize(num_points);
+  for (size_t s = 0; s < num_samples; ++s) {
+    double previous = 0;
+    for (size_t k = 0; k < num_points; ++k) {
+      double flow = 0;
+      for (uint32_t j = 0; j < runs; ++j) flow += flows[s * runs + j][k];
+      flow /= runs;
+      result.flow[k].add(flow);
+      if (k > 0) result.flow_difference[k].add(flow - previous);
+      previous = flow;
+    }
+  }
+  for (size_t k = 0; k < num_points; ++k) {
+    const bool warm = config.warm_start && k > 0;
+    const int steps = (warm ? config.warm_start_steps : config.warmup_steps) +
+                      config.measure_steps;
+    result.vehicle_steps +=
+        int64_t(num_samples) * runs * steps * vehiclesAt(config, k);
+  }
+  return result;
+}
+
+#endif  // MONTECARLO_SWEEP_H_
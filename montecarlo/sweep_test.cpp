@@ -0,0 +1,95 @@
+#include "sweep.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <set>
+#include <vector>
+
+namespace {
+
+SweepConfig smallSweep(Sampling sampling) {
+  SweepConfig config{.params = {.num_cells = 300},
+                     .points = {},
+                     .warmup_steps = 200,
+                     .warm_start_steps = 50,
+                     .measure_steps = 200,
+                     .seed = 17,
+                     .sampling = sampling,
+                     .qmc_points = 4};
+  for (double density : {0.1, 0.15, 0.2, 0.25}) {
+    config.points.push_back({density, 0.3f});
+  }
+  return config;
+}
+
+}  // namespace
+
+TEST(SweepTest, VanDerCorputStratifies) {
+  // The first 2^m points fall in distinct intervals of width 2^-m, and a
+  // digital shift permutes those intervals.
+  for (uint32_t shift : {0u, 0x9E3779B9u}) {
+    std::set<uint32_t> intervals;
+    for (uint32_t j = 0; j < 16; ++j) {
+      intervals.insert((vanDerCorput(j) ^ shift) >> 28);
+    }
+    EXPECT_EQ(16, intervals.size());
+  }
+  EXPECT_EQ(0x80000000u, vanDerCorput(1));
+  EXPECT_EQ(0xC0000000u, vanDerCorput(3));
+}
+
+TEST(SweepTest, AntitheticStreamComplements) {
+  MaskedStream plain(PhiloxStream(3, 1, 2), 0);
+  MaskedStream antithetic(PhiloxStream(3, 1, 2), ~0u);
+  std::vector<uint32_t> filled(20);
+  antithetic.fill(filled);
+  for (uint32_t x : filled) EXPECT_EQ(~x, plain());
+}
+
+TEST(SweepTest, SameResultForAnyNumberOfThreads) {
+  const SweepConfig config = smallSweep(Sampling::kQuasiMonteCarlo);
+  WorkStealingPool one(1), three(3);
+  const SweepResult a = runSweep(config, 6, one);
+  const SweepResult b = runSweep(config, 6, three);
+  for (size_t k = 0; k < config.points.size(); ++k) {
+    EXPECT_EQ(a.flow[k].mean(), b.flow[k].mean());
+    EXPECT_EQ(a.flow[k].variance(), b.flow[k].variance());
+  }
+  EXPECT_EQ(a.vehicle_steps, b.vehicle_steps);
+}
+
+TEST(SweepTest, VarianceReductionKeepsTheMean) {
+  SweepConfig independent = smallSweep(Sampling::kIndependent);
+  independent.common_random_numbers = false;
+  independent.warm_start = false;
+  WorkStealingPool pool(2);
+  const SweepResult base = runSweep(independent, 64, pool);
+  for (Sampling sampling :
+       {Sampling::kAntithetic, Sampling::kQuasiMonteCarlo}) {
+    const SweepResult reduced = runSweep(smallSweep(sampling), 16, pool);
+    for (size_t k = 0; k < independent.points.size(); ++k) {
+      const double se = std::hypot(base.flow[k].standardError(),
+                                   reduced.flow[k].standardError());
+      EXPECT_NEAR(base.flow[k].mean(), reduced.flow[k].mean(), 4 * se);
+    }
+  }
+}
+
+TEST(SweepTest, CommonRandomNumbersSharpenDifferences) {
+  // Above the critical density, where runs at nearby densities stay coupled.
+  SweepConfig config = smallSweep(Sampling::kIndependent);
+  config.points = {{0.3, 0.3f}, {0.35, 0.3f}, {0.4, 0.3f}, {0.45, 0.3f}};
+  config.warm_start = false;
+  SweepConfig independent = config;
+  independent.common_random_numbers = false;
+  WorkStealingPool pool(2);
+  const SweepResult common = runSweep(config, 64, pool);
+  const SweepResult separate = runSweep(independent, 64, pool);
+  double common_variance = 0, separate_variance = 0;
+  for (size_t k = 1; k < config.points.size(); ++k) {
+    common_variance += common.flow_difference[k].variance();
+    separate_variance += separate.flow_difference[k].variance();
+  }
+  EXPECT_LT(common_variance, separate_variance);
+}
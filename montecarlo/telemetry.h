@@ -0,0 +1,361 @@
+#ifndef MONTECARLO_TELEMETRY_H_
+#define MONTECARLO_TELEMETRY_H_
+
+// Per-step statistics and space-time snapshots of a NaSchRoad, streamed to a
+// compact binary file for offline analysis.
+//
+// TelemetryWriter collects steps into a batch of columns. A full batch is
+// handed to a background thread that writes it while the simulation fills
+// the other one, so the simulation only waits if the disk can't keep up.
+//
+// Format, little-endian on any host:
+//   "NSTM", u32 version (1), i32 num_cells, u32 snapshot_every,
+//   then batches until the end of the file, each
+//     u32 num_steps (k), then one column at a time:
+//       i64 step[k], f32 flow[k], f32 mean_velocity[k], i32 stopped[k],
+//       i32 num_jams[k], i32 largest_jam[k],
+//     u32 num_snapshots (m), then m times
+//       i64 step, i8 cells[num_cells] (a vehicle's velocity, up to 127, or
+//       -1).
+
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "nasch.h"
+
+struct StepStats {
+  int64_t step = 0;
+  // Vehicles passing a point per step, averaged over all points.
+  float flow = 0;
+  float mean_velocity = 0;
+  int32_t stopped = 0;
+  // Jams are chains of at least two stopped vehicles, each right behind the
+  // next.
+  int32_t num_jams = 0;
+  int32_t largest_jam = 0;
+};
+
+inline StepStats stepStats(const NaSchRoad& road, int64_t step) {
+  const auto vel = road.velocities();
+  const int32_t n = road.numVehicles();
+  StepStats stats{.step = step};
+  stats.flow = float(road.lastStepDistance()) / road.numCells();
+  stats.mean_velocity = float(road.lastStepDistance()) / n;
+
+  const auto pos = road.positions();
+  const int32_t cells = road.numCells();
+  // Whether vehicle i is stopped right behind a stopped vehicle.
+  auto joined = [&](int32_t i) {
+    if (vel[i] != 0) return false;
+    const int32_t ahead = i + 1 == n ? 0 : i + 1;
+    const int32_t gap = pos[ahead] - pos[i] - 1;
+    return vel[ahead] == 0 && (gap == 0 || gap + cells == 0);
+  };
+  // Start scanning after a break in the chain, so that no jam wraps around
+  // the end of the arrays.
+  int32_t start = 0;
+  while (start < n && joined(start)) ++start;
+  if (start == n) {
+    stats.stopped = n;
+    stats.num_jams = n > 1 ? 1 : 0;
+    stats.largest_jam = n > 1 ? n : 0;
+    return stats;
+  }
+  int32_t run = 0;
+  for (int32_t k = 1, i = start + 1; k <= n; ++k, ++i) {
+    if (i == n) i = 0;
+    stats.stopped += vel[i] == 0;
+    if (joined(i)) {
+      ++run;
+    } else if (run > 0) {
+      ++stats.num_jams;
+      stats.largest_jam = std::max(stats.largest_jam, run + 1);
+      run = 0;
+    }
+  }
+  return stats;
+}
+
+// The columns of a run of steps, and its snapshots.
+struct TelemetryBatch {
+  size_t size() const { return step.size(); }
+
+  void clear() {
+    step.clear();
+    flow.clear();
+    mean_velocity.clear();
+    stopped.clear();
+    num_jams.clear();
+    largest_jam.clear();
+    snapshot_steps.clear();
+    snapshot_cells.clear();
+  }
+
+  void add(const StepStats& stats) {
+    step.push_back(stats.step);
+    flow.push_back(stats.flow);
+    mean_velocity.push_back(stats.mean_velocity);
+    stopped.push_back(stats.stopped);
+    num_jams.push_back(stats.num_jams);
+    largest_jam.push_back(stats.largest_jam);
+  }
+
+  std::vector<int64_t> step;
+  std::vector<float> flow;
+  std::vector<float> mean_velocity;
+  std::vector<int32_t> stopped;
+  std::vector<int32_t> num_jams;
+  std::vector<int32_t> largest_jam;
+  // num_cells cells per snapshot, one after the other.
+  std::vector<int64_t> snapshot_steps;
+  std::vector<int8_t> snapshot_cells;
+};
+
+struct TelemetryOptions {
+  size_t batch_steps = 4096;
+  // Record the whole road every this many steps, or never if 0.
+  uint32_t snapshot_every = 0;
+};
+
+// Converts v between host and little-endian byte order, either way.
+template <typename V>
+inline void swapLittleEndian(V& v) {
+  if constexpr (std::endian::native == std::endian::big) {
+    char* bytes = reinterpret_cast<char*>(&v);
+    std::reverse(bytes, bytes + sizeof(V));
+  }
+}
+
+class TelemetryWriter {
+ public:
+  // `out` must outlive the writer.
+  TelemetryWriter(std::ostream& out,
+                  int32_t num_cells,
+                  const TelemetryOptions& options = {})
+      : out_(out), num_cells_(num_cells), options_(options) {
+    out_.write("NSTM", 4);
+    writeValue(kVersion);
+    writeValue(num_cells);
+    writeValue(options.snapshot_every);
+    thread_ = std::thread([this] { writerLoop(); });
+  }
+
+  ~TelemetryWriter() {
+    if (thread_.joinable()) finish();
+  }
+
+  TelemetryWriter(const TelemetryWriter&) = delete;
+  TelemetryWriter& operator=(const TelemetryWriter&) = delete;
+
+  // Records the road's state after step `step`.
+  void record(const NaSchRoad& road, int64_t step) {
+    TelemetryBatch& batch = batches_[front_];
+    batch.add(stepStats(road, step));
+    if (options_.snapshot_every > 0 && step % options_.snapshot_every == 0) {
+      batch.snapshot_steps.push_back(step);
+      const size_t offset = batch.snapshot_cells.size();
+      batch.snapshot_cells.resize(offset + num_cells_, -1);
+      int8_t* cells = batch.snapshot_cells.data() + offset;
+      const auto pos = road.positions();
+      const auto vel = road.velocities();
+      for (size_t i = 0; i < pos.size(); ++i) {
+        cells[pos[i]] = std::min(vel[i], 127);
+      }
+    }
+    if (batch.size() >= options_.batch_steps) flushFront();
+  }
+
+  // Writes what is left and stops the background thread. Throws if any write
+  // failed.
+  void close() {
+    finish();
+    if (failed_) throw std::runtime_error("Telemetry write failed");
+  }
+
+ private:
+  static constexpr uint32_t kVersion = 1;
+
+  template <typename V>
+  void writeValue(V v) {
+    swapLittleEndian(v);
+    out_.write(reinterpret_cast<const char*>(&v), sizeof(V));
+  }
+
+  template <typename V>
+  void writeColumn(const std::vector<V>& column) {
+    if constexpr (std::endian::native == std::endian::little) {
+      out_.write(reinterpret_cast<const char*>(column.data()),
+                 column.size() * sizeof(V));
+    } else {
+      for (const V& v : column) writeValue(v);
+    }
+  }
+
+  void writeBatch(const TelemetryBatch& batch) {
+    writeValue(uint32_t(batch.size()));
+    writeColumn(batch.step);
+    writeColumn(batch.flow);
+    writeColumn(batch.mean_velocity);
+    writeColumn(batch.stopped);
+    writeColumn(batch.num_jams);
+    writeColumn(batch.largest_jam);
+    writeValue(uint32_t(batch.snapshot_steps.size()));
+    for (size_t s = 0; s < batch.snapshot_steps.size(); ++s) {
+      writeValue(batch.snapshot_steps[s]);
+      out_.write(
+          reinterpret_cast<const char*>(batch.snapshot_cells.data()) +
+              s * num_cells_,
+          num_cells_);
+    }
+  }
+
+  // Hands the front batch to the writer thread, once it is done with the
+  // other one.
+  void flushFront() {
+    std::unique_lock lock(mu_);
+    cv_.wait(lock, [this] { return !pending_; });
+    pending_ = true;
+    front_ = 1 - front_;
+    batches_[front_].clear();
+    cv_.notify_all();
+  }
+
+  void finish() {
+    if (batches_[front_].size() > 0) flushFront();
+    {
+      std::lock_guard lock(mu_);
+      done_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    out_.flush();
+    failed_ = failed_ || !out_;
+  }
+
+  void writerLoop() {
+    std::unique_lock lock(mu_);
+    while (true) {
+      cv_.wait(lock, [this] { return pending_ || done_; });
+      if (!pending_) return;
+      // The simulation doesn't touch the back batch while it is pending.
+      const TelemetryBatch& back = batches_[1 - front_];
+      lock.unlock();
+      writeBatch(back);
+      lock.lock();
+      pending_ = false;
+      cv_.notify_all();
+    }
+  }
+
+  std::ostream& out_;
+  int32_t num_cells_;
+  TelemetryOptions options_;
+  TelemetryBatch batches_[2];
+  int front_ = 0;  // The batch being filled; the other may be pending.
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool pending_ = false;
+  bool done_ = false;
+  bool failed_ = false;
+  std::thread thread_;
+};
+
+class TelemetryReader {
+ public:
+  // Reads the header. Throws if `in` is not a telemetry file.
+  explicit TelemetryReader(std::istream& in) : in_(in) {
+    char magic[4];
+    uint32_t version = 0;
+    in_.read(magic, 4);
+    readValue(version);
+    readValue(num_cells_);
+    readValue(snapshot_every_);
+    if (!in_ || std::memcmp(magic, "NSTM", 4) != 0 || version != 1 ||
+        num_cells_ <= 0) {
+      throw std::runtime_error("Not a telemetry file");
+    }
+  }
+
+  int32_t numCells() const { return num_cells_; }
+  uint32_t snapshotEvery() const { return snapshot_every_; }
+
+  // Reads the next batch, replacing `batch`. Returns false at the end of the
+  // file, and throws if it ends partway through a batch.
+  bool nextBatch(TelemetryBatch& batch) {
+    batch.clear();
+    uint32_t k = 0;
+    if (!in_.read(reinterpret_cast<char*>(&k), sizeof(k))) {
+      if (in_.gcount() == 0) return false;
+      throw std::runtime_error("Truncated telemetry batch");
+    }
+    swapLittleEndian(k);
+    readColumn(batch.step, k);
+    readColumn(batch.flow, k);
+    readColumn(batch.mean_velocity, k);
+    readColumn(batch.stopped, k);
+    readColumn(batch.num_jams, k);
+    readColumn(batch.largest_jam, k);
+    uint32_t m = 0;
+    readValue(m);
+    batch.snapshot_steps.resize(m);
+    batch.snapshot_cells.resize(size_t(m) * num_cells_);
+    for (uint32_t s = 0; s < m; ++s) {
+      readValue(batch.snapshot_steps[s]);
+      in_.read(reinterpret_cast<char*>(batch.snapshot_cells.data()) +
+                   size_t(s) * num_cells_,
+               num_cells_);
+    }
+    if (!in_) throw std::runtime_error("Truncated telemetry batch");
+    return true;
+  }
+
+  // Everything left in the file, as one batch.
+  TelemetryBatch readAll() {
+    TelemetryBatch all, batch;
+    while (nextBatch(batch)) {
+      append(all.step, batch.step);
+      append(all.flow, batch.flow);
+      append(all.mean_velocity, batch.mean_velocity);
+      append(all.stopped, batch.stopped);
+      append(all.num_jams, batch.num_jams);
+      append(all.largest_jam, batch.largest_jam);
+      append(all.snapshot_steps, batch.snapshot_steps);
+      append(all.snapshot_cells, batch.snapshot_cells);
+    }
+    return all;
+  }
+
+ private:
+  template <typename V>
+  void readValue(V& v) {
+    in_.read(reinterpret_cast<char*>(&v), sizeof(V));
+    swapLittleEndian(v);
+  }
+
+  template <typename V>
+  void readColumn(std::vector<V>& column, size_t size) {
+    column.resize(size);
+    in_.read(reinterpret_cast<char*>(column.data()), size * sizeof(V));
+    for (V& v : column) swapLittleEndian(v);
+  }
+
+  template <typename V>
+  static void append(std::vector<V>& to, const std::vector<V>& from) {
+    to.insert(to.end(), from.begin(), from.end());
+  }
+
+  std::istream& in_;
+  int32_t num_cells_ = 0;
+  uint32_t snapshot_every_ = 0;
+};
+
+#endif  // MONTECARLO_TELEMETRY_H_
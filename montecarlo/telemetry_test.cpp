@@ -0,0 +1,122 @@
+#include "telemetry.h"
+
+#include <gtest/gtest.h>
+
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "philox.h"
+
+using ::testing::ElementsAre;
+
+TEST(TelemetryTest, CountsJams) {
+  // Cells 0-2 and 9 form one jam across the wrap-around, 5-6 another; 7 is
+  // stopped but not behind anyone, and 4 is moving.
+  NaSchRoad road({.num_cells = 10, .max_velocity = 5, .slowdown_p = 0},
+                 {0, 1, 2, 4, 5, 6, 8, 9},
+                 {0, 0, 0, 1, 0, 0, 0, 0});
+  const StepStats stats = stepStats(road, 7);
+  EXPECT_EQ(7, stats.step);
+  EXPECT_EQ(7, stats.stopped);
+  EXPECT_EQ(2, stats.num_jams);
+  EXPECT_EQ(5, stats.largest_jam);
+}
+
+TEST(TelemetryTest, FullRoadIsOneJam) {
+  std::vector<int32_t> cells(6);
+  std::iota(cells.begin(), cells.end(), 0);
+  NaSchRoad road({.num_cells = 6}, cells, std::vector<int32_t>(6, 0));
+  const StepStats stats = stepStats(road, 0);
+  EXPECT_EQ(1, stats.num_jams);
+  EXPECT_EQ(6, stats.largest_jam);
+}
+
+TEST(TelemetryTest, RoundTrips) {
+  const NaSchParams params{.num_cells = 50, .slowdown_p = 0.3f};
+  auto road = NaSchRoad::evenlySpaced(params, 20);
+  std::stringstream file;
+  std::vector<StepStats> expected;
+  std::vector<int8_t> last_snapshot(params.num_cells, -1);
+  {
+    // Small batches, so that several are in flight.
+    TelemetryWriter writer(
+        file, params.num_cells, {.batch_steps = 16, .snapshot_every = 10});
+    PhiloxStream gen(1, 0, 0);
+    for (int64_t t = 1; t <= 100; ++t) {
+      road.step(gen);
+      writer.record(road, t);
+      expected.push_back(stepStats(road, t));
+    }
+    for (size_t i = 0; i < road.positions().size(); ++i) {
+      last_snapshot[road.positions()[i]] = road.velocities()[i];
+    }
+    writer.close();
+  }
+
+  TelemetryReader reader(file);
+  EXPECT_EQ(50, reader.numCells());
+  EXPECT_EQ(10, reader.snapshotEvery());
+  const TelemetryBatch all = reader.readAll();
+  ASSERT_EQ(100, all.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].step, all.step[i]);
+    EXPECT_EQ(expected[i].flow, all.flow[i]);
+    EXPECT_EQ(expected[i].mean_velocity, all.mean_velocity[i]);
+    EXPECT_EQ(expected[i].stopped, all.stopped[i]);
+    EXPECT_EQ(expected[i].num_jams, all.num_jams[i]);
+    EXPECT_EQ(expected[i].largest_jam, all.largest_jam[i]);
+  }
+  ASSERT_EQ(10, all.snapshot_steps.size());
+  EXPECT_EQ(100, all.snapshot_steps.back());
+  EXPECT_TRUE(std::equal(last_snapshot.begin(),
+                         last_snapshot.end(),
+                         all.snapshot_cells.end() - params.num_cells));
+}
+
+TEST(TelemetryTest, RejectsOtherFiles) {
+  std::stringstream file("not telemetry at all");
+  EXPECT_THROW(TelemetryReader reader(file), std::runtime_error);
+}
+
+TEST(TelemetryTest, RejectsInvalidNumCells) {
+  for (int32_t num_cells : {0, -1}) {
+    std::stringstream file;
+    file.write("NSTM", 4);
+    const uint32_t version = 1, snapshot_every = 0;
+    file.write(reinterpret_cast<const char*>(&version), 4);
+    file.write(reinterpret_cast<const char*>(&num_cells), 4);
+    file.write(reinterpret_cast<const char*>(&snapshot_every), 4);
+    EXPECT_THROW(TelemetryReader reader(file), std::runtime_error);
+  }
+}
+
+TEST(TelemetryTest, RejectsTruncatedBatches) {
+  std::stringstream file;
+  {
+    TelemetryWriter writer(file, 10);
+    writer.record(NaSchRoad::evenlySpaced({.num_cells = 10}, 3), 0);
+  }
+  const std::string bytes = file.str();
+  std::stringstream truncated(bytes.substr(0, bytes.size() - 2));
+  TelemetryReader reader(truncated);
+  TelemetryBatch batch;
+  EXPECT_THROW(reader.nextBatch(batch), std::runtime_error);
+}
+
+TEST(TelemetryTest, RejectsTruncatedBatchHeader) {
+  std::stringstream file;
+  {
+    TelemetryWriter writer(file, 10);
+    writer.record(NaSchRoad::evenlySpaced({.num_cells = 10}, 3), 0);
+  }
+  // Two of the four bytes of a second batch's step count.
+  std::stringstream truncated(file.str() + std::string(2, '\0'));
+  TelemetryReader reader(truncated);
+  TelemetryBatch batch;
+  EXPECT_TRUE(reader.nextBatch(batch));
+  EXPECT_THROW(reader.nextBatch(batch), std::runtime_error);
+}
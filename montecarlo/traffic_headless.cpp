@@ -0,0 +1,98 @@
+// Runs the Nagel-Schreckenberg model with no rendering, for throughput.
+// Optionally streams per-step statistics, and a snapshot of the road every
+// snapshot_every steps, to a telemetry file (see telemetry.h and
+// traffic_telemetry.cpp).
+//
+// Run in opt mode for accurate throughput, with:
+// bazel run --compilation_mode=opt montecarlo:traffic_headless --
+//     [cells] [density] [steps] [max_velocity] [slowdown_p]
+//     [telemetry_file] [snapshot_every]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+#include "absl/random/random.h"
+#include "nasch.h"
+#include "telemetry.h"
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+  NaSchParams params{.num_cells = 10'000'000};
+  double density = 0.2;
+  int steps = 100;
+  if (argc > 1) params.num_cells = std::atoi(argv[1]);
+  if (argc > 2) density = std::atof(argv[2]);
+  if (argc > 3) steps = std::atoi(argv[3]);
+  if (argc > 4) params.max_velocity = std::atoi(argv[4]);
+  if (argc > 5) params.slowdown_p = std::atof(argv[5]);
+  const char* telemetry_path = argc > 6 ? argv[6] : nullptr;
+  TelemetryOptions telemetry_options;
+  if (argc > 7) telemetry_options.snapshot_every = std::atoi(argv[7]);
+  const size_t num_vehicles = density * params.num_cells;
+  if (params.num_cells <= 0 || num_vehicles == 0 ||
+      num_vehicles > size_t(params.num_cells)) {
+    std::fprintf(stderr,
+                 "Usage: %s [cells] [density in (0, 1]] [steps] "
+                 "[max_velocity] [slowdown_p] [telemetry_file] "
+                 "[snapshot_every]\n",
+                 argv[0]);
+    return 1;
+  }
+
+  std::ofstream telemetry_file;
+  std::unique_ptr<TelemetryWriter> telemetry;
+  if (telemetry_path != nullptr) {
+    telemetry_file.open(telemetry_path, std::ios::binary);
+    if (!telemetry_file) {
+      std::fprintf(stderr, "Cannot open %s\n", telemetry_path);
+      return 1;
+    }
+    telemetry = std::make_unique<TelemetryWriter>(
+        telemetry_file, params.num_cells, telemetry_options);
+  }
+
+  auto road = NaSchRoad::evenlySpaced(params, num_vehicles);
+  absl::BitGen gen(std::seed_seq{2147483647});
+  std::printf("%d cells, %zu vehicles, max velocity %d, p = %.2f\n",
+              params.num_cells,
+              num_vehicles,
+              params.max_velocity,
+              params.slowdown_p);
+
+  const int report_every = std::max(1, steps / 10);
+  int64_t distance = 0;
+  const auto start = Clock::now();
+  for (int t = 0; t < steps; ++t) {
+    road.step(gen);
+    distance += road.lastStepDistance();
+    if (telemetry) telemetry->record(road, t + 1);
+    if ((t + 1) % report_every == 0 || t + 1 == steps) {
+      std::printf("step %6d  mean velocity %.3f\n",
+                  t + 1,
+                  double(road.lastStepDistance()) / num_vehicles);
+    }
+  }
+  if (telemetry) {
+    try {
+      telemetry->close();
+    } catch (const std::runtime_error& e) {
+      std::fprintf(stderr, "%s: %s\n", telemetry_path, e.what());
+      return 1;
+    }
+  }
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  std::printf("flow %.4f vehicles/step past a point\n",
+              double(distance) / steps / params.num_cells);
+  std::printf("%.3g cell-updates/s, %.3g vehicle-updates/s\n",
+              double(params.num_cells) * steps / elapsed.count(),
+              double(num_vehicles) * steps / elapsed.count());
+  return 0;
+}
@@ -0,0 +1,70 @@
+// Estimates flow in the Nagel-Schreckenberg model from many independent
+// replications, on all cores. Results are the same for any thread count.
+//
+// Run in opt mode, with:
+// bazel run --compilation_mode=opt montecarlo:traffic_replications --
+//     [replications] [threads] [cells] [density] [steps] [slowdown_p]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "replications.h"
+#include "systems/work_stealing_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+  size_t num_replications = 1000;
+  size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+  ReplicationConfig config;
+  config.params.num_cells = 1000;
+  double density = 0.2;
+  if (argc > 1) num_replications = std::atoi(argv[1]);
+  if (argc > 2) num_threads = std::max(1, std::atoi(argv[2]));
+  if (argc > 3) config.params.num_cells = std::atoi(argv[3]);
+  if (argc > 4) density = std::atof(argv[4]);
+  if (argc > 5) config.measure_steps = config.warmup_steps = std::atoi(argv[5]);
+  if (argc > 6) config.params.slowdown_p = std::atof(argv[6]);
+  config.num_vehicles = density * config.params.num_cells;
+  config.detector_cells =
+      std::min(config.detector_cells, config.params.num_cells);
+  if (num_replications == 0 || config.num_vehicles == 0 ||
+      config.num_vehicles > size_t(config.params.num_cells)) {
+    std::fprintf(stderr,
+                 "Usage: %s [replications] [threads] [cells] "
+                 "[density in (0, 1]] [steps] [slowdown_p]\n",
+                 argv[0]);
+    return 1;
+  }
+
+  WorkStealingPool pool(num_threads);
+  const auto start = Clock::now();
+  const FlowEstimate estimate =
+      runReplications(config, num_replications, pool);
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  std::printf("%zu replications of %d + %d steps on %zu threads: %.2f s\n",
+              num_replications,
+              config.warmup_steps,
+              config.measure_steps,
+              pool.size(),
+              elapsed.count());
+  auto print = [](const char* name, const RunningStats& stats) {
+    std::printf("%-9s %.6f +- %.6f (95%% CI), sd %.6f\n",
+                name,
+                stats.mean(),
+                stats.halfWidth(),
+                stats.stddev());
+  };
+  print("flow", estimate.flow);
+  print("density", estimate.density);
+  print("velocity", estimate.velocity);
+  std::printf("%.3g cell-updates/s\n",
+              double(config.params.num_cells) * num_replications *
+                  (config.warmup_steps + config.measure_steps) /
+                  elapsed.count());
+  return 0;
+}
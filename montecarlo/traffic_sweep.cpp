@@ -0,0 +1,133 @@
+// Sweeps the flow-density diagram of the Nagel-Schreckenberg model with
+// variance reduction, and compares against independent, cold-started runs
+// at every point: variance per unit of work, and the time each would take to
+// reach a target confidence interval at every point.
+//
+// Run in opt mode, with:
+// bazel run --compilation_mode=opt montecarlo:traffic_sweep --
+//     [samples] [threads] [sampling: iid|antithetic|qmc] [half_width]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+#include "sweep.h"
+#include "systems/work_stealing_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Timed {
+  SweepResult result;
+  double seconds;
+};
+
+Timed timedSweep(const SweepConfig& config,
+                 size_t num_samples,
+                 WorkStealingPool& pool) {
+  const auto start = Clock::now();
+  SweepResult result = runSweep(config, num_samples, pool);
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+  return {std::move(result), elapsed.count()};
+}
+
+// Seconds to reach `half_width` at every point, at the measured variance and
+// cost per sample.
+double secondsForHalfWidth(const Timed& t,
+                           size_t num_samples,
+                           double half_width) {
+  size_t needed = 0;
+  for (const RunningStats& flow : t.result.flow) {
+    needed = std::max(needed, flow.samplesForHalfWidth(half_width));
+  }
+  return t.seconds / num_samples * needed;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t num_samples = 64;
+  size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+  double half_width = 0.001;
+  SweepConfig config{.params = {.num_cells = 1000}, .points = {}};
+  if (argc > 1) num_samples = std::max(2, std::atoi(argv[1]));
+  if (argc > 2) num_threads = std::max(1, std::atoi(argv[2]));
+  if (argc > 3) {
+    if (std::strcmp(argv[3], "iid") == 0) {
+      config.sampling = Sampling::kIndependent;
+    } else if (std::strcmp(argv[3], "qmc") == 0) {
+      config.sampling = Sampling::kQuasiMonteCarlo;
+    }
+  }
+  if (argc > 4) half_width = std::atof(argv[4]);
+  for (float p : {0.1f, 0.3f, 0.5f}) {
+    for (int d = 1; d <= 8; ++d) config.points.push_back({d * 0.05, p});
+  }
+
+  // The same work for both: the baseline gets as many runs as the method.
+  SweepConfig baseline = config;
+  baseline.sampling = Sampling::kIndependent;
+  baseline.common_random_numbers = false;
+  baseline.warm_start = false;
+  const size_t baseline_samples = num_samples * runsPerSample(config);
+
+  WorkStealingPool pool(num_threads);
+  const Timed base = timedSweep(baseline, baseline_samples, pool);
+  const Timed reduced = timedSweep(config, num_samples, pool);
+
+  std::printf("%zu samples of %u runs each vs %zu independent runs, %zu "
+              "threads\n",
+              num_samples,
+              runsPerSample(config),
+              baseline_samples,
+              pool.size());
+  std::printf("density  p     flow                  variance reduction "
+              "(per unit work)\n");
+  std::printf("                                     point    difference\n");
+  const double work_ratio = double(reduced.result.vehicle_steps) /
+                            double(base.result.vehicle_steps);
+  for (size_t k = 0; k < config.points.size(); ++k) {
+    const RunningStats& flow = reduced.result.flow[k];
+    // Variance of one sample times the work per sample, relative to the
+    // baseline's.
+    auto factor = [&](const RunningStats& b, const RunningStats& r) {
+      return b.variance() / baseline_samples /
+             (r.variance() / num_samples * work_ratio);
+    };
+    std::printf("%.2f     %.1f   %.5f +- %.5f     %7.2f",
+                config.points[k].density,
+                config.points[k].slowdown_p,
+                flow.mean(),
+                flow.halfWidth(),
+                factor(base.result.flow[k], flow));
+    const bool same_p =
+        k > 0 && config.points[k].slowdown_p == config.points[k - 1].slowdown_p;
+    if (same_p) {
+      std::printf("  %7.2f",
+                  factor(base.result.flow_difference[k],
+                         reduced.result.flow_difference[k]));
+    }
+    std::printf("\n");
+  }
+
+  const double base_target =
+      secondsForHalfWidth(base, baseline_samples, half_width);
+  const double reduced_target =
+      secondsForHalfWidth(reduced, num_samples, half_width);
+  std::printf("Sweep time: %.2f s independent, %.2f s reduced\n",
+              base.seconds,
+              reduced.seconds);
+  std::printf("For +- %.4f at every point: %.1f s independent, %.1f s "
+              "reduced, %.1f s (%.0f%%) saved\n",
+              half_width,
+              base_target,
+              reduced_target,
+              base_target - reduced_target,
+              100 * (1 - reduced_target / base_target));
+  return 0;
+}
@@ -0,0 +1,91 @@
+// Summarizes a telemetry file written by traffic_headless, batch by batch, so
+// files of any length fit in memory. Optionally writes the per-step columns
+// as CSV.
+//
+// bazel run montecarlo:traffic_telemetry -- telemetry_file [csv_file]
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include "running_stats.h"
+#include "telemetry.h"
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "Usage: %s telemetry_file [csv_file]\n", argv[0]);
+    return 1;
+  }
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in) {
+    std::fprintf(stderr, "Cannot open %s\n", argv[1]);
+    return 1;
+  }
+  std::FILE* csv = nullptr;
+  if (argc > 2) {
+    csv = std::fopen(argv[2], "w");
+    if (csv == nullptr) {
+      std::fprintf(stderr, "Cannot open %s\n", argv[2]);
+      return 1;
+    }
+    std::fprintf(csv, "step,flow,mean_velocity,stopped,num_jams,largest_jam\n");
+  }
+
+  try {
+    TelemetryReader reader(in);
+    RunningStats flow, mean_velocity, stopped, num_jams;
+    int32_t largest_jam = 0;
+    size_t num_snapshots = 0;
+    TelemetryBatch batch;
+    while (reader.nextBatch(batch)) {
+      for (size_t i = 0; i < batch.size(); ++i) {
+        flow.add(batch.flow[i]);
+        mean_velocity.add(batch.mean_velocity[i]);
+        stopped.add(batch.stopped[i]);
+        num_jams.add(batch.num_jams[i]);
+        largest_jam = std::max(largest_jam, batch.largest_jam[i]);
+        if (csv != nullptr) {
+          std::fprintf(csv,
+                       "%lld,%g,%g,%d,%d,%d\n",
+                       static_cast<long long>(batch.step[i]),
+                       batch.flow[i],
+                       batch.mean_velocity[i],
+                       batch.stopped[i],
+                       batch.num_jams[i],
+                       batch.largest_jam[i]);
+        }
+      }
+      num_snapshots += batch.snapshot_steps.size();
+    }
+
+    std::printf("%d cells, %zu steps, %zu snapshots\n",
+                reader.numCells(),
+                flow.count(),
+                num_snapshots);
+    std::printf(
+        "flow           %.4f ± %.4f (sd)\n", flow.mean(), flow.stddev());
+    std::printf("mean velocity  %.4f ± %.4f (sd)\n",
+                mean_velocity.mean(),
+                mean_velocity.stddev());
+    std::printf("stopped        %.1f ± %.1f (sd)\n",
+                stopped.mean(),
+                stopped.stddev());
+    std::printf("jams           %.1f ± %.1f (sd), largest %d vehicles\n",
+                num_jams.mean(),
+                num_jams.stddev(),
+                largest_jam);
+  } catch (const std::runtime_error& e) {
+    std::fprintf(stderr, "%s: %s\n", argv[1], e.what());
+    if (csv != nullptr) std::fclose(csv);
+    return 1;
+  }
+  if (csv != nullptr) {
+    const bool failed = std::ferror(csv) != 0;
+    if (std::fclose(csv) != 0 || failed) {
+      std::fprintf(stderr, "%s: Write failed\n", argv[2]);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -1,126 +1,274 @@
+// Hash map benchmarks over table sizes, key types, probe patterns and
+// workloads, comparing absl::flat_hash_map against absl::node_hash_map,
+// std::unordered_map and absl::btree_map.
+//
+// Benchmarks are named <workload>/<map>/<key>[/<order>]/size:N[/hit_pct:H]:
+//   Lookup   kProbesPerIteration finds, hit_pct% of them for keys in the map,
+//            visiting the keys in sorted ("seq"), uniformly random ("random")
+//            or Zipfian ("zipf") order. Misses are for random absent keys.
+//   Insert   builds a map of N keys from empty, without reserving, and
+//            reports the heap bytes and allocations per entry of the result.
+//   Erase    erases all N keys, in random order, from a copy of the map.
+//   Iterate  sums the values of all N entries.
+// Every map maps keys to values of the same type: int64_t, Uuid (16 bytes,
+// stored inline and hashed with UuidHash) or the same UUIDs as strings (36
+// characters, too long for the small-string buffer, so two heap allocations
+// per entry). Sizes go from L1-resident (1Ki int entries) to DRAM-resident
+// (2Mi entries); throughput is reported as items/s, next to hardware and
+// allocation counters per iteration (see instrumentation.h).
+//
 // Run in opt mode for accurate timings, with:
-// bazel run --compilation_mode=opt :bench
+// bazel run --compilation_mode=opt systems:bench --
+//     --benchmark_out=hash_maps.json --benchmark_out_format=json
+// and select a subset with e.g. --benchmark_filter='Lookup/flat_hash_map/'.
+// The JSON output records the run's context and every benchmark's items/s,
+// for comparing runs with google_benchmark's tools/compare.py.
 
 #include <benchmark/benchmark.h>
-#include <uuid/uuid.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <random>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
+#include "absl/container/btree_map.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/node_hash_map.h"
+#include "absl/hash/hash.h"
 #include "absl/random/random.h"
+#include "instrumentation.h"
+#include "uuid.h"
 
-constexpr int kNumElems = 300000;
-constexpr int kMaxRange = kNumElems * 2;
+constexpr int64_t kSizes[] = {1 << 10, 1 << 14, 1 << 18, 1 << 21};
+constexpr int64_t kHitPercents[] = {100, 50, 0};
+constexpr size_t kProbesPerIteration = 1 << 16;
+// absl::Zipf needs an exponent above 1; this is close to the 0.99 of YCSB.
+constexpr double kZipfExponent = 1.1;
 
-std::string genUUID() {
-  uuid_t uuid;
-  char uuid_str[37];  // 36 characters + null terminator
-  uuid_generate(uuid);
-  uuid_unparse(uuid, uuid_str);
-  return std::string(uuid_str);
-}
+enum class Order { kSequential, kRandom, kZipfian };
+
+// absl's default hash for int and string keys, and UuidHash for Uuid.
+// std::unordered_map picks up UuidHash through std::hash<Uuid>.
+template <typename K>
+using HashFor =
+    std::conditional_t<std::is_same_v<K, Uuid>, UuidHash, absl::Hash<K>>;
 
-absl::flat_hash_map<int, std::string> createFlatHashMap(int num_elems,
-                                                        int max_range) {
-  absl::BitGen gen;
-  absl::flat_hash_map<int, std::string> uuids;
-  for (size_t i = 0; i < num_elems; ++i) {
-    int key = absl::Uniform(gen, 0, max_range);
-    uuids[key] = genUUID();
+template <typename K>
+K randomKey(absl::BitGen& gen) {
+  if constexpr (std::is_same_v<K, int64_t>) {
+    return int64_t(absl::Uniform<uint64_t>(gen));
+  } else if constexpr (std::is_same_v<K, Uuid>) {
+    return Uuid::random(gen);
+  } else {
+    return Uuid::random(gen).toString();
   }
-  return uuids;
 }
 
-std::unordered_map<int, std::string> createUnorderedMap(int num_elems,
-                                                        int max_range) {
-  absl::BitGen gen;
-  std::unordered_map<int, std::string> uuids;
-  for (size_t i = 0; i < num_elems; ++i) {
-    int key = absl::Uniform(gen, 0, max_range);
-    uuids[key] = genUUID();
+template <typename K>
+const char* keyName() {
+  if constexpr (std::is_same_v<K, int64_t>) return "int64";
+  if constexpr (std::is_same_v<K, Uuid>) return "uuid";
+  return "string";
+}
+
+// A cheap summary of a value, to keep lookups and loops from being optimized
+// away.
+uint64_t checksum(int64_t value) { return value; }
+uint64_t checksum(const Uuid& value) { return value.lo(); }
+uint64_t checksum(const std::string& value) { return value.size(); }
+
+// `size` keys to put in the map, in random order, and as many that are not.
+template <typename K>
+struct KeySet {
+  std::vector<K> present;
+  std::vector<K> sorted;
+  std::vector<K> absent;
+};
+
+// The same keys for every benchmark of a given size and key type. Only the
+// last set is kept, as benchmarks are registered size by size.
+template <typename K>
+const KeySet<K>& keySet(size_t size) {
+  static size_t cached_size = 0;
+  static KeySet<K> keys;
+  if (cached_size != size) {
+    absl::BitGen gen(std::seed_seq{int(size)});
+    absl::flat_hash_set<K> seen;
+    std::vector<K> all;
+    while (all.size() < 2 * size) {
+      K key = randomKey<K>(gen);
+      if (seen.insert(key).second) all.push_back(std::move(key));
+    }
+    keys.present.assign(all.begin(), all.begin() + size);
+    keys.absent.assign(all.begin() + size, all.end());
+    keys.sorted = keys.present;
+    std::sort(keys.sorted.begin(), keys.sorted.end());
+    cached_size = size;
   }
-  return uuids;
+  return keys;
 }
 
-static void BM_FlatHashMap_Contains(benchmark::State &state) {
-  const auto uuid_map = createFlatHashMap(kNumElems, kMaxRange);
-  int char_count = 0;
-  for (auto _ : state) {
-    for (size_t i = 0; i < kMaxRange; ++i) {
-      if (uuid_map.contains(i)) {
-        char_count += uuid_map.at(i).size();
-      } else {
-        benchmark::DoNotOptimize(--char_count);
-      }
+template <typename Map>
+Map buildMap(const std::vector<typename Map::key_type>& keys) {
+  Map map;
+  for (const auto& key : keys) map.emplace(key, key);
+  return map;
+}
+
+template <typename K>
+std::vector<K> makeProbes(const KeySet<K>& keys, double hit, Order order) {
+  absl::BitGen gen(std::seed_seq{1});
+  const size_t n = keys.present.size();
+  std::vector<K> probes;
+  probes.reserve(kProbesPerIteration);
+  size_t next = 0;
+  for (size_t i = 0; i < kProbesPerIteration; ++i) {
+    if (!absl::Bernoulli(gen, hit)) {
+      probes.push_back(keys.absent[absl::Uniform<size_t>(gen, 0, n)]);
+      continue;
+    }
+    switch (order) {
+      case Order::kSequential:
+        probes.push_back(keys.sorted[next++ % n]);
+        break;
+      case Order::kRandom:
+        probes.push_back(keys.present[absl::Uniform<size_t>(gen, 0, n)]);
+        break;
+      case Order::kZipfian:
+        // Present keys are in random order, so popular keys are scattered
+        // across the table.
+        probes.push_back(
+            keys.present[absl::Zipf<size_t>(gen, n - 1, kZipfExponent)]);
+        break;
     }
   }
+  return probes;
 }
-// Register the function as a benchmark
-BENCHMARK(BM_FlatHashMap_Contains);
 
-static void BM_FlatHashMap_FindEnd(benchmark::State &state) {
-  const auto uuid_map = createFlatHashMap(kNumElems, kMaxRange);
-  int char_count = 0;
+template <typename Map>
+void BM_Lookup(benchmark::State& state, Order order) {
+  using K = typename Map::key_type;
+  const KeySet<K>& keys = keySet<K>(state.range(0));
+  const Map map = buildMap<Map>(keys.present);
+  const std::vector<K> probes =
+      makeProbes(keys, state.range(1) / 100.0, order);
+  uint64_t sum = 0;
+  BenchmarkCounters counters(state);
   for (auto _ : state) {
-    for (size_t i = 0; i < kMaxRange; ++i) {
-      const auto it = uuid_map.find(i);
-      if (it != uuid_map.end()) {
-        char_count += it->second.size();
-      } else {
-        benchmark::DoNotOptimize(--char_count);
-      }
+    for (const K& key : probes) {
+      const auto it = map.find(key);
+      if (it != map.end()) sum += checksum(it->second);
     }
+    benchmark::DoNotOptimize(sum);
   }
+  counters.stop();
+  state.SetItemsProcessed(state.iterations() * probes.size());
 }
-BENCHMARK(BM_FlatHashMap_FindEnd);
 
-static void BM_FlatHashMap_FindEnd_Flipped(benchmark::State &state) {
-  const auto uuid_map = createFlatHashMap(kNumElems, kMaxRange);
-  int char_count = 0;
+template <typename Map>
+void BM_Insert(benchmark::State& state) {
+  const auto& keys = keySet<typename Map::key_type>(state.range(0)).present;
+  BenchmarkCounters counters(state);
   for (auto _ : state) {
-    for (size_t i = 0; i < kMaxRange; ++i) {
-      const auto it = uuid_map.find(i);
-      if (it == uuid_map.end()) {
-        benchmark::DoNotOptimize(--char_count);
-      } else {
-        char_count += it->second.size();
-      }
-    }
+    Map map = buildMap<Map>(keys);
+    benchmark::DoNotOptimize(map);
   }
+  counters.stop();
+  state.SetItemsProcessed(state.iterations() * keys.size());
+
+  const int64_t bytes_before = liveHeapBytes();
+  const int64_t allocations_before = allocationCounts().allocations;
+  const Map map = buildMap<Map>(keys);
+  state.counters["bytes/entry"] =
+      double(liveHeapBytes() - bytes_before) / keys.size();
+  state.counters["allocs/entry"] =
+      double(allocationCounts().allocations - allocations_before) /
+      keys.size();
 }
-// BENCHMARK(BM_FlatHashMap_FindEnd_Flipped);
 
-static void BM_UnorderedMap_Contains(benchmark::State &state) {
-  const auto uuid_map = createUnorderedMap(kNumElems, kMaxRange);
-  int char_count = 0;
+template <typename Map>
+void BM_Erase(benchmark::State& state) {
+  const auto& keys = keySet<typename Map::key_type>(state.range(0)).present;
+  const Map full = buildMap<Map>(keys);
+  BenchmarkCounters counters(state);
   for (auto _ : state) {
-    for (size_t i = 0; i < kMaxRange; ++i) {
-      if (uuid_map.contains(i)) {
-        char_count += uuid_map.at(i).size();
-      } else {
-        benchmark::DoNotOptimize(--char_count);
-      }
-    }
+    state.PauseTiming();
+    counters.pause();
+    Map map = full;
+    counters.resume();
+    state.ResumeTiming();
+    for (const auto& key : keys) map.erase(key);
+    benchmark::DoNotOptimize(map);
   }
+  counters.stop();
+  state.SetItemsProcessed(state.iterations() * keys.size());
 }
-// Register the function as a benchmark
-// BENCHMARK(BM_UnorderedMap_Contains);
 
-static void BM_UnorderedMap_FindEnd(benchmark::State &state) {
-  const auto uuid_map = createUnorderedMap(kNumElems, kMaxRange);
-  int char_count = 0;
+template <typename Map>
+void BM_Iterate(benchmark::State& state) {
+  const Map map =
+      buildMap<Map>(keySet<typename Map::key_type>(state.range(0)).present);
+  uint64_t sum = 0;
+  BenchmarkCounters counters(state);
   for (auto _ : state) {
-    for (size_t i = 0; i < kMaxRange; ++i) {
-      const auto it = uuid_map.find(i);
-      if (it == uuid_map.end()) {
-        benchmark::DoNotOptimize(--char_count);
-      } else {
-        char_count += it->second.size();
-      }
+    for (const auto& [key, value] : map) sum += checksum(value);
+    benchmark::DoNotOptimize(sum);
+  }
+  counters.stop();
+  state.SetItemsProcessed(state.iterations() * map.size());
+}
+
+template <typename Map>
+void registerMap(const std::string& map_name, int64_t size) {
+  const std::string name = map_name + "/" + keyName<typename Map::key_type>();
+  const std::pair<Order, const char*> orders[] = {
+      {Order::kSequential, "seq"},
+      {Order::kRandom, "random"},
+      {Order::kZipfian, "zipf"}};
+  for (const auto& [order, order_name] : orders) {
+    for (int64_t hit : kHitPercents) {
+      benchmark::RegisterBenchmark(
+          ("Lookup/" + name + "/" + order_name).c_str(),
+          [order](benchmark::State& state) { BM_Lookup<Map>(state, order); })
+          ->Args({size, hit})
+          ->ArgNames({"size", "hit_pct"});
     }
   }
+  benchmark::RegisterBenchmark(("Insert/" + name).c_str(), BM_Insert<Map>)
+      ->Arg(size)
+      ->ArgName("size");
+  benchmark::RegisterBenchmark(("Erase/" + name).c_str(), BM_Erase<Map>)
+      ->Arg(size)
+      ->ArgName("size");
+  benchmark::RegisterBenchmark(("Iterate/" + name).c_str(), BM_Iterate<Map>)
+      ->Arg(size)
+      ->ArgName("size");
 }
-// BENCHMARK(BM_UnorderedMap_FindEnd);
 
-BENCHMARK_MAIN();
\ No newline at end of file
+template <typename K>
+void registerKey() {
+  for (int64_t size : kSizes) {
+    registerMap<absl::flat_hash_map<K, K, HashFor<K>>>("flat_hash_map", size);
+    registerMap<absl::node_hash_map<K, K, HashFor<K>>>("node_hash_map", size);
+    registerMap<std::unordered_map<K, K>>("unordered_map", size);
+    registerMap<absl::btree_map<K, K>>("btree_map", size);
+  }
+}
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  registerKey<int64_t>();
+  registerKey<Uuid>();
+  registerKey<std::string>();
+  benchmark::AddCustomContext("probes_per_iteration",
+                              std::to_string(kProbesPerIteration));
+  benchmark::AddCustomContext("zipf_exponent", std::to_string(kZipfExponent));
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,332 @@
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <string>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::atomic<int64_t> num_allocations{0};
+std::atomic<int64_t> allocated_bytes{0};
+std::atomic<int64_t> live_bytes{0};
+
+void count(int64_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  live_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+#ifdef __GLIBC__
+
+// With glibc, the malloc family itself is replaced, forwarding to glibc's own
+// entry points, so allocations that bypass operator new (Eigen's, C
+// libraries') are counted too. operator new calls malloc.
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t align, size_t size);
+void __libc_free(void* p);
+
+}  // extern "C"
+
+namespace {
+
+void* counted(void* p) {
+  if (p != nullptr) count(malloc_usable_size(p));
+  return p;
+}
+
+}  // namespace
+
+extern "C" {
+
+void* malloc(size_t size) noexcept { return counted(__libc_malloc(size)); }
+
+void* calloc(size_t num, size_t size) noexcept {
+  return counted(__libc_calloc(num, size));
+}
+
+// Counted as freeing the old block and allocating a new one.
+void* realloc(void* p, size_t size) noexcept {
+  const int64_t old_size = p == nullptr ? 0 : malloc_usable_size(p);
+  void* q = __libc_realloc(p, size);
+  // On failure p is untouched, unless size is 0, which frees it.
+  if (q == nullptr && size != 0) return nullptr;
+  live_bytes.fetch_sub(old_size, std::memory_order_relaxed);
+  return counted(q);
+}
+
+void* memalign(size_t align, size_t size) noexcept {
+  return counted(__libc_memalign(align, size));
+}
+
+void* aligned_alloc(size_t align, size_t size) noexcept {
+  return counted(__libc_memalign(align, size));
+}
+
+int posix_memalign(void** out, size_t align, size_t size) noexcept {
+  if (align % sizeof(void*) != 0 || (align & (align - 1)) != 0) return EINVAL;
+  void* p = __libc_memalign(align, size);
+  if (p == nullptr) return ENOMEM;
+  *out = counted(p);
+  return 0;
+}
+
+void* valloc(size_t size) noexcept {
+  return counted(__libc_memalign(getpagesize(), size));
+}
+
+void free(void* p) noexcept {
+  if (p == nullptr) return;
+  live_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+  __libc_free(p);
+}
+
+}  // extern "C"
+
+#else
+
+// Elsewhere, only operator new is counted, by the size requested, which is
+// kept in a header in front of each block.
+namespace {
+
+constexpr size_t kHeader = alignof(std::max_align_t);
+
+void* countedNew(size_t size, size_t align) {
+  const size_t offset = std::max(kHeader, align);
+  void* base;
+  if (align > kHeader) {
+    // aligned_alloc needs a multiple of the alignment.
+    const size_t rounded = (offset + size + align - 1) / align * align;
+    base = std::aligned_alloc(align, rounded);
+  } else {
+    base = std::malloc(offset + size);
+  }
+  if (base == nullptr) throw std::bad_alloc();
+  char* p = static_cast<char*>(base) + offset;
+  std::memcpy(p - sizeof(size_t), &size, sizeof(size_t));
+  count(size);
+  return p;
+}
+
+void countedDelete(void* p, size_t align) {
+  if (p == nullptr) return;
+  char* block = static_cast<char*>(p);
+  size_t size;
+  std::memcpy(&size, block - sizeof(size_t), sizeof(size_t));
+  live_bytes.fetch_sub(size, std::memory_order_relaxed);
+  std::free(block - std::max(kHeader, align));
+}
+
+}  // namespace
+
+// The array and nothrow forms forward to these by default.
+void* operator new(size_t size) { return countedNew(size, 0); }
+void* operator new(size_t size, std::align_val_t align) {
+  return countedNew(size, static_cast<size_t>(align));
+}
+void operator delete(void* p) noexcept { countedDelete(p, 0); }
+void operator delete(void* p, size_t) noexcept { countedDelete(p, 0); }
+void operator delete(void* p, std::align_val_t align) noexcept {
+  countedDelete(p, static_cast<size_t>(align));
+}
+void operator delete(void* p, size_t, std::align_val_t align) noexcept {
+  countedDelete(p, static_cast<size_t>(align));
+}
+
+#endif  // __GLIBC__
+
+AllocationCounts allocationCounts() {
+  return {.allocations = num_allocations.load(std::memory_order_relaxed),
+          .bytes = allocated_bytes.load(std::memory_order_relaxed)};
+}
+
+int64_t liveHeapBytes() { return live_bytes.load(std::memory_order_relaxed); }
+
+void resetPeakRss() {
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+  std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+double peakRssBytes() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.starts_with("VmHWM:")) return 1024.0 * std::stod(line.substr(6));
+  }
+  return 0;
+}
+
+#ifdef __linux__
+
+namespace {
+
+struct PerfEvent {
+  uint32_t type;
+  uint64_t config;
+};
+
+// In PerfCounters::Event order.
+constexpr PerfEvent kPerfEvents[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}};
+
+int openPerfEvent(const PerfEvent& event) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  attr.disabled = 1;
+  // User space only, which perf_event_paranoid allows up to level 2.
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // Also count threads started later, e.g. a thread pool's workers. Their
+  // counts are added to this event's as they exit.
+  attr.inherit = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+}  // namespace
+
+PerfCounters::PerfCounters() {
+  for (int e = 0; e < kNumEvents; ++e) {
+    fds_[e] = openPerfEvent(kPerfEvents[e]);
+    if (fds_[e] < 0) error_ = errno;
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : fds_) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+void PerfCounters::enable() {
+  for (int fd : fds_) {
+    if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+void PerfCounters::disable() {
+  for (int fd : fds_) {
+    if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  }
+}
+
+std::array<double, PerfCounters::kNumEvents> PerfCounters::read() const {
+  std::array<double, kNumEvents> counts{};
+  for (int e = 0; e < kNumEvents; ++e) {
+    // value, time enabled, time running.
+    uint64_t values[3];
+    if (fds_[e] < 0 ||
+        ::read(fds_[e], values, sizeof(values)) != sizeof(values) ||
+        values[2] == 0) {
+      continue;
+    }
+    counts[e] = double(values[0]) * values[1] / values[2];
+  }
+  return counts;
+}
+
+#else
+
+PerfCounters::PerfCounters() {
+  fds_.fill(-1);
+  error_ = ENOSYS;
+}
+PerfCounters::~PerfCounters() = default;
+void PerfCounters::enable() {}
+void PerfCounters::disable() {}
+std::array<double, PerfCounters::kNumEvents> PerfCounters::read() const {
+  return {};
+}
+
+#endif  // __linux__
+
+bool PerfCounters::anyAvailable() const {
+  for (int e = 0; e < kNumEvents; ++e) {
+    if (available(Event(e))) return true;
+  }
+  return false;
+}
+
+BenchmarkCounters::BenchmarkCounters(benchmark::State& state)
+    : state_(state) {
+  if (!perf_.anyAvailable()) {
+    static std::once_flag warned;
+    std::call_once(warned, [this] {
+      std::fprintf(stderr,
+                   "Hardware performance counters are unavailable (%s); "
+                   "reporting allocations only.\n",
+                   std::strerror(perf_.error()));
+    });
+  }
+  resume();
+}
+
+void BenchmarkCounters::pause() {
+  if (!running_) return;
+  perf_.disable();
+  const AllocationCounts now = allocationCounts();
+  total_.allocations += now.allocations - start_.allocations;
+  total_.bytes += now.bytes - start_.bytes;
+  running_ = false;
+}
+
+void BenchmarkCounters::resume() {
+  if (running_ || stopped_) return;
+  start_ = allocationCounts();
+  perf_.enable();
+  running_ = true;
+}
+
+void BenchmarkCounters::stop() {
+  if (stopped_) return;
+  pause();
+  stopped_ = true;
+  // Read everything before inserting counters, which allocates.
+  const auto counts = perf_.read();
+  for (int e = 0; e < PerfCounters::kNumEvents; ++e) {
+    if (!perf_.available(PerfCounters::Event(e))) continue;
+    state_.counters[PerfCounters::kEventNames[e]] =
+        benchmark::Counter(counts[e], benchmark::Counter::kAvgIterations);
+  }
+  state_.counters["allocs"] = benchmark::Counter(
+      total_.allocations, benchmark::Counter::kAvgIterations);
+  state_.counters["alloc_bytes"] =
+      benchmark::Counter(total_.bytes, benchmark::Counter::kAvgIterations);
+}
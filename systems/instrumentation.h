@@ -0,0 +1,112 @@
+#ifndef SYSTEMS_INSTRUMENTATION_H_
+#define SYSTEMS_INSTRUMENTATION_H_
+
+// Instrumentation shared by the google_benchmark targets: hardware
+// performance counters, heap allocation counts and peak memory, reported as
+// user counters next to the wall time.
+//
+// Linking this library replaces malloc and its relatives (with glibc) or the
+// global operator new and delete (elsewhere) with versions that count every
+// allocation, so only link it into benchmarks.
+//
+// Typical use, around a benchmark loop:
+//   BenchmarkCounters counters(state);
+//   for (auto _ : state) { ... }
+//   counters.stop();
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+
+// Allocations since the program started. With glibc these are all heap
+// allocations, including Eigen's, and bytes are usable sizes as reported by
+// malloc, which round requests up; a realloc counts as one allocation.
+// Elsewhere only operator new is counted, by requested size.
+struct AllocationCounts {
+  int64_t allocations = 0;
+  int64_t bytes = 0;
+};
+AllocationCounts allocationCounts();
+
+// Heap bytes counted by allocationCounts() and not yet freed.
+int64_t liveHeapBytes();
+
+// Linux only: returns freed heap memory to the OS and restarts the peak
+// resident set size count (VmHWM) from the current RSS.
+void resetPeakRss();
+
+// Peak resident set size since the last resetPeakRss(), or 0 if unknown.
+double peakRssBytes();
+
+// Hardware counters, in user space, read through perf_event_open, of the
+// calling thread and of the threads it starts afterwards (added in as they
+// exit). Events the kernel or CPU won't count (no PMU in a VM,
+// perf_event_paranoid, not Linux) are skipped, so any subset may be
+// available. Counting starts disabled.
+class PerfCounters {
+ public:
+  enum Event {
+    kCycles,
+    kInstructions,
+    kL1DataMisses,
+    kLastLevelMisses,
+    kBranchMisses,
+    kNumEvents
+  };
+  static constexpr std::array<const char*, kNumEvents> kEventNames = {
+      "CYCLES", "INSTRUCTIONS", "L1D_MISSES", "LLC_MISSES", "BRANCH_MISSES"};
+
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool available(Event event) const { return fds_[event] >= 0; }
+  bool anyAvailable() const;
+  // The errno of the last event that failed to open, or 0.
+  int error() const { return error_; }
+
+  void enable();
+  void disable();
+
+  // Counts while enabled, scaled up if the kernel had to multiplex counters.
+  // Unavailable events read 0.
+  std::array<double, kNumEvents> read() const;
+
+ private:
+  std::array<int, kNumEvents> fds_;
+  int error_ = 0;
+};
+
+// Attaches per-iteration counters to a benchmark for the code between
+// construction and stop(): every available PerfCounters event, plus "allocs"
+// and "alloc_bytes". pause() and resume() leave out setup done between
+// state.PauseTiming() and state.ResumeTiming(). If no hardware counter is
+// available, a note is printed once and only allocations are reported.
+// To count a thread pool's workers, start it after the counters and join it
+// before stop().
+class BenchmarkCounters {
+ public:
+  explicit BenchmarkCounters(benchmark::State& state);
+  ~BenchmarkCounters() { stop(); }
+
+  BenchmarkCounters(const BenchmarkCounters&) = delete;
+  BenchmarkCounters& operator=(const BenchmarkCounters&) = delete;
+
+  void pause();
+  void resume();
+  // Stops counting and sets the counters. Later calls do nothing.
+  void stop();
+
+ private:
+  benchmark::State& state_;
+  PerfCounters perf_;
+  AllocationCounts start_;
+  AllocationCounts total_;
+  bool running_ = false;
+  bool stopped_ = false;
+};
+
+#endif  // SYSTEMS_INSTRUMENTATION_H_
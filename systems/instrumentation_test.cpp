@@ -0,0 +1,70 @@
+#include "instrumentation.h"
+
+#include <gtest/gtest.h>
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+TEST(InstrumentationTest, CountsAllocations) {
+  const AllocationCounts before = allocationCounts();
+  const int64_t live_before = liveHeapBytes();
+  auto buffer = std::make_unique<std::vector<char>>(1000);
+  const AllocationCounts after = allocationCounts();
+  EXPECT_EQ(before.allocations + 2, after.allocations);
+  EXPECT_GE(after.bytes - before.bytes, 1000 + int64_t(sizeof(*buffer)));
+  EXPECT_EQ(after.bytes - before.bytes, liveHeapBytes() - live_before);
+
+  buffer.reset();
+  EXPECT_EQ(live_before, liveHeapBytes());
+  EXPECT_EQ(after.allocations, allocationCounts().allocations);
+}
+
+TEST(InstrumentationTest, CountsOverAlignedAllocations) {
+  struct alignas(256) Block {
+    char bytes[100];
+  };
+  const AllocationCounts before = allocationCounts();
+  auto block = std::make_unique<Block>();
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(block.get()) % 256);
+  EXPECT_EQ(before.allocations + 1, allocationCounts().allocations);
+  EXPECT_GE(allocationCounts().bytes - before.bytes, 256);
+}
+
+TEST(InstrumentationTest, CountsEigenAllocations) {
+#ifndef __GLIBC__
+  GTEST_SKIP() << "Only operator new is counted without glibc";
+#endif
+  const AllocationCounts before = allocationCounts();
+  const int64_t live_before = liveHeapBytes();
+  auto matrix = std::make_unique<Eigen::MatrixXf>(128, 256);
+  EXPECT_EQ(before.allocations + 2, allocationCounts().allocations);
+  EXPECT_GE(allocationCounts().bytes - before.bytes,
+            int64_t(128 * 256 * sizeof(float)));
+
+  matrix.reset();
+  EXPECT_EQ(live_before, liveHeapBytes());
+}
+
+TEST(InstrumentationTest, PerfCountersCountOnlyWhileEnabled) {
+  PerfCounters perf;
+  if (!perf.anyAvailable()) {
+    GTEST_SKIP() << "No hardware counters: " << perf.error();
+  }
+  volatile int64_t sum = 0;
+  perf.enable();
+  for (int i = 0; i < 100000; ++i) sum = sum + i;
+  perf.disable();
+  const auto counts = perf.read();
+  if (perf.available(PerfCounters::kInstructions)) {
+    EXPECT_GT(counts[PerfCounters::kInstructions], 100000);
+  }
+  for (int i = 0; i < 100000; ++i) sum = sum + i;
+  EXPECT_EQ(counts, perf.read());
+}
+
+TEST(InstrumentationTest, ReadsPeakRss) {
+  resetPeakRss();
+  EXPECT_GT(peakRssBytes(), 0);
+}
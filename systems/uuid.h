@@ -0,0 +1,130 @@
+#ifndef SYSTEMS_UUID_H_
+#define SYSTEMS_UUID_H_
+
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// A 128-bit UUID held inline as two 64-bit halves, so maps keyed or valued by
+// it store it in place, with no heap allocation per entry. Halves are
+// big-endian (hi holds bytes 0-7), so ordering matches the byte order and the
+// text form.
+class Uuid {
+ public:
+  // The nil UUID.
+  constexpr Uuid() = default;
+  constexpr Uuid(uint64_t hi, uint64_t lo) : hi_(hi), lo_(lo) {}
+
+  // A random (version 4) UUID.
+  template <typename URBG>
+  static Uuid random(URBG& gen) {
+    std::uniform_int_distribution<uint64_t> bits;
+    const uint64_t hi = bits(gen), lo = bits(gen);
+    return Uuid((hi & ~0xF000ull) | 0x4000ull,
+                (lo & ~(0xC0ull << 56)) | (0x80ull << 56));
+  }
+
+  // From 16 bytes, e.g. a libuuid uuid_t.
+  static Uuid fromBytes(const unsigned char* bytes) {
+    uint64_t hi = 0, lo = 0;
+    for (int i = 0; i < 8; ++i) {
+      hi = (hi << 8) | bytes[i];
+      lo = (lo << 8) | bytes[i + 8];
+    }
+    return Uuid(hi, lo);
+  }
+
+  // From the canonical form, e.g. "123e4567-e89b-12d3-a456-426614174000", in
+  // either case. Throws std::invalid_argument if `text` is not one.
+  static Uuid parse(std::string_view text) {
+    if (text.size() != 36) throw std::invalid_argument("Malformed UUID");
+    uint64_t halves[2] = {0, 0};
+    int digits = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+      const char c = text[i];
+      if (i == 8 || i == 13 || i == 18 || i == 23) {
+        if (c != '-') throw std::invalid_argument("Malformed UUID");
+        continue;
+      }
+      int value;
+      if (c >= '0' && c <= '9') {
+        value = c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        value = c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        value = c - 'A' + 10;
+      } else {
+        throw std::invalid_argument("Malformed UUID");
+      }
+      uint64_t& half = halves[digits++ / 16];
+      half = (half << 4) | value;
+    }
+    return Uuid(halves[0], halves[1]);
+  }
+
+  uint64_t hi() const { return hi_; }
+  uint64_t lo() const { return lo_; }
+  int version() const { return (hi_ >> 12) & 0xF; }
+
+  std::array<unsigned char, 16> bytes() const {
+    std::array<unsigned char, 16> bytes;
+    for (int i = 0; i < 8; ++i) {
+      bytes[i] = hi_ >> (56 - 8 * i);
+      bytes[i + 8] = lo_ >> (56 - 8 * i);
+    }
+    return bytes;
+  }
+
+  // The canonical lowercase form, 36 characters.
+  std::string toString() const {
+    static constexpr char kHex[] = "0123456789abcdef";
+    std::string text(36, '-');
+    int digit = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+      if (i == 8 || i == 13 || i == 18 || i == 23) continue;
+      const uint64_t half = digit < 16 ? hi_ : lo_;
+      text[i] = kHex[(half >> (60 - 4 * (digit % 16))) & 0xF];
+      ++digit;
+    }
+    return text;
+  }
+
+  friend constexpr bool operator==(const Uuid&, const Uuid&) = default;
+  friend constexpr auto operator<=>(const Uuid&, const Uuid&) = default;
+
+  template <typename H>
+  friend H AbslHashValue(H h, const Uuid& uuid) {
+    return H::combine(std::move(h), uuid.hi_, uuid.lo_);
+  }
+
+ private:
+  uint64_t hi_ = 0;
+  uint64_t lo_ = 0;
+};
+
+static_assert(sizeof(Uuid) == 16);
+
+// A fast hash for Uuid: one 64x64->128-bit multiply of the two halves (each
+// offset by a constant), folded to 64 bits, as in wyhash. Every input bit
+// reaches both the high and low bits of the result, so sequential or
+// time-based UUIDs spread as well as random ones.
+struct UuidHash {
+  size_t operator()(const Uuid& uuid) const {
+    const unsigned __int128 product =
+        static_cast<unsigned __int128>(uuid.hi() ^ 0xA0761D6478BD642Full) *
+        (uuid.lo() ^ 0xE7037ED1A0B428DBull);
+    return uint64_t(product) ^ uint64_t(product >> 64);
+  }
+};
+
+template <>
+struct std::hash<Uuid> : UuidHash {};
+
+#endif  // SYSTEMS_UUID_H_
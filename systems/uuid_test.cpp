@@ -0,0 +1,73 @@
+#include "uuid.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <unordered_set>
+
+TEST(UuidTest, RandomIsVersion4) {
+  std::mt19937_64 gen(1);
+  for (int i = 0; i < 100; ++i) {
+    const Uuid uuid = Uuid::random(gen);
+    EXPECT_EQ(4, uuid.version());
+    EXPECT_EQ(0x80, uuid.bytes()[8] & 0xC0);  // RFC 4122 variant.
+  }
+}
+
+TEST(UuidTest, TextRoundTrips) {
+  const Uuid uuid = Uuid::parse("123E4567-e89b-12d3-a456-426614174000");
+  EXPECT_EQ(0x123e4567e89b12d3u, uuid.hi());
+  EXPECT_EQ(0xa456426614174000u, uuid.lo());
+  EXPECT_EQ(1, uuid.version());
+  EXPECT_EQ("123e4567-e89b-12d3-a456-426614174000", uuid.toString());
+  EXPECT_EQ("00000000-0000-0000-0000-000000000000", Uuid().toString());
+
+  std::mt19937_64 gen(2);
+  const Uuid random = Uuid::random(gen);
+  EXPECT_EQ(random, Uuid::parse(random.toString()));
+}
+
+TEST(UuidTest, BytesRoundTrip) {
+  const Uuid uuid(0x0123456789abcdef, 0xfedcba9876543210);
+  const auto bytes = uuid.bytes();
+  EXPECT_EQ(0x01, bytes[0]);
+  EXPECT_EQ(0x10, bytes[15]);
+  EXPECT_EQ(uuid, Uuid::fromBytes(bytes.data()));
+}
+
+TEST(UuidTest, ParseRejectsMalformedText) {
+  EXPECT_THROW(Uuid::parse(""), std::invalid_argument);
+  EXPECT_THROW(Uuid::parse("123e4567e89b12d3a456426614174000"),
+               std::invalid_argument);
+  EXPECT_THROW(Uuid::parse("123e4567-e89b-12d3-a456-42661417400g"),
+               std::invalid_argument);
+  EXPECT_THROW(Uuid::parse("123e4567-e89b-12d3-a456_426614174000"),
+               std::invalid_argument);
+}
+
+TEST(UuidTest, OrdersLikeText) {
+  std::mt19937_64 gen(3);
+  std::set<Uuid> uuids;
+  for (int i = 0; i < 100; ++i) uuids.insert(Uuid::random(gen));
+  std::string previous;
+  for (const Uuid& uuid : uuids) {
+    EXPECT_LT(previous, uuid.toString());
+    previous = uuid.toString();
+  }
+}
+
+TEST(UuidTest, HashSpreadsSequentialUuids) {
+  // Hash tables index by the low bits and, in absl's case, also keep the 7
+  // bits above them, so both ends of the hash must vary.
+  std::unordered_set<size_t> low, high;
+  for (uint64_t i = 0; i < 4096; ++i) {
+    const size_t hash = UuidHash()(Uuid(0x0190000000007000, i));
+    low.insert(hash & 0xFFF);
+    high.insert(hash >> 52);
+  }
+  // 4096 random 12-bit values cover about 63% of them.
+  EXPECT_GT(low.size(), 2400u);
+  EXPECT_GT(high.size(), 2400u);
+}
@@ -0,0 +1,156 @@
+#ifndef SYSTEMS_WORK_STEALING_POOL_H_
+#define SYSTEMS_WORK_STEALING_POOL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed-size pool of worker threads that runs data-parallel loops.
+//
+// parallelFor() hands each worker a contiguous range of task indices. A worker
+// pops tasks from the front of its own range, and once that is exhausted it
+// steals the back half of another worker's range. This keeps all threads busy
+// even when the per-task cost is very skewed, while the common case (no
+// stealing) only touches the worker's own cache line.
+//
+// The calling thread participates as worker 0, so a pool of size 1 runs
+// everything inline and spawns no threads.
+class WorkStealingPool {
+ public:
+  explicit WorkStealingPool(
+      size_t num_threads = std::max(1u, std::thread::hardware_concurrency()))
+      : ranges_(std::max<size_t>(1, num_threads)) {
+    for (size_t w = 1; w < ranges_.size(); ++w) {
+      threads_.emplace_back([this, w] { workerLoop(w); });
+    }
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard lock(mu_);
+      stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto& t : threads_) t.join();
+  }
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  size_t size() const { return ranges_.size(); }
+
+  // Runs fn(task, worker) once for every task in [0, num_tasks), and blocks
+  // until all of them have completed. `worker` is in [0, size()) and is stable
+  // for the duration of a call, so it can index per-thread scratch buffers.
+  // Not reentrant: fn must not call parallelFor on the same pool.
+  void parallelFor(size_t num_tasks,
+                   const std::function<void(size_t, size_t)>& fn) {
+    if (num_tasks == 0) return;
+    const size_t num_workers = ranges_.size();
+    for (size_t w = 0; w < num_workers; ++w) {
+      std::lock_guard lock(ranges_[w].mu);
+      ranges_[w].begin = num_tasks * w / num_workers;
+      ranges_[w].end = num_tasks * (w + 1) / num_workers;
+    }
+
+    {
+      std::lock_guard lock(mu_);
+      fn_ = &fn;
+      busy_workers_ = num_workers - 1;
+      ++generation_;
+    }
+    start_cv_.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock lock(mu_);
+    done_cv_.wait(lock, [this] { return busy_workers_ == 0; });
+    fn_ = nullptr;
+  }
+
+ private:
+  // Each worker's pending tasks are the half-open range [begin, end). Padded
+  // to a cache line so that owners popping tasks don't false-share.
+  struct alignas(64) TaskRange {
+    std::mutex mu;
+    size_t begin = 0;
+    size_t end = 0;
+  };
+
+  bool popOwn(size_t w, size_t& task) {
+    auto& r = ranges_[w];
+    std::lock_guard lock(r.mu);
+    if (r.begin == r.end) return false;
+    task = r.begin++;
+    return true;
+  }
+
+  // Steals the back half of the fullest-looking victim. Returns the first
+  // stolen task to run immediately, and installs the rest as our own range.
+  bool steal(size_t w, size_t& task) {
+    const size_t num_workers = ranges_.size();
+    for (size_t i = 1; i < num_workers; ++i) {
+      auto& victim = ranges_[(w + i) % num_workers];
+      size_t begin, end;
+      {
+        std::lock_guard lock(victim.mu);
+        const size_t remaining = victim.end - victim.begin;
+        if (remaining == 0) continue;
+        end = victim.end;
+        begin = victim.end - (remaining + 1) / 2;
+        victim.end = begin;
+      }
+      task = begin;
+      auto& own = ranges_[w];
+      std::lock_guard lock(own.mu);
+      own.begin = begin + 1;
+      own.end = end;
+      return true;
+    }
+    return false;
+  }
+
+  void runTasks(size_t w) {
+    size_t task;
+    while (popOwn(w, task) || steal(w, task)) {
+      (*fn_)(task, w);
+    }
+  }
+
+  void workerLoop(size_t w) {
+    size_t seen_generation = 0;
+    while (true) {
+      {
+        std::unique_lock lock(mu_);
+        start_cv_.wait(lock, [&] {
+          return stop_ || generation_ != seen_generation;
+        });
+        if (stop_) return;
+        seen_generation = generation_;
+      }
+
+      runTasks(w);
+
+      std::lock_guard lock(mu_);
+      if (--busy_workers_ == 0) done_cv_.notify_one();
+    }
+  }
+
+  std::vector<TaskRange> ranges_;
+  std::vector<std::thread> threads_;
+
+  std::mutex mu_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  const std::function<void(size_t, size_t)>* fn_ = nullptr;
+  size_t generation_ = 0;
+  size_t busy_workers_ = 0;
+  bool stop_ = false;
+};
+
+#endif  // SYSTEMS_WORK_STEALING_POOL_H_
@@ -0,0 +1,56 @@
+#include "work_stealing_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+using ::testing::Each;
+
+TEST(WorkStealingPoolTest, RunsEveryTaskExactlyOnce) {
+  for (size_t num_threads : {1, 2, 3, 8}) {
+    WorkStealingPool pool(num_threads);
+    EXPECT_EQ(num_threads, pool.size());
+
+    for (size_t num_tasks : {0, 1, 7, 1000}) {
+      std::vector<std::atomic<int>> counts(num_tasks);
+      pool.parallelFor(num_tasks, [&](size_t task, size_t worker) {
+        EXPECT_LT(worker, num_threads);
+        counts[task].fetch_add(1);
+      });
+      for (const auto& c : counts) EXPECT_EQ(1, c.load());
+    }
+  }
+}
+
+TEST(WorkStealingPoolTest, SkewedTasksAreStolen) {
+  // All of the expensive tasks land in worker 0's initial range, so the other
+  // workers only get to run them by stealing.
+  WorkStealingPool pool(4);
+  std::vector<size_t> ran_on(64);
+  pool.parallelFor(ran_on.size(), [&](size_t task, size_t worker) {
+    if (task < 16) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    ran_on[task] = worker;
+  });
+
+  std::vector<int> tasks_per_worker(pool.size());
+  for (size_t task = 0; task < 16; ++task) ++tasks_per_worker[ran_on[task]];
+  EXPECT_LT(tasks_per_worker[0], 16);
+}
+
+TEST(WorkStealingPoolTest, PerWorkerBuffersNeedNoSynchronization) {
+  WorkStealingPool pool(4);
+  std::vector<std::vector<size_t>> buffers(pool.size());
+  pool.parallelFor(10000, [&](size_t task, size_t worker) {
+    buffers[worker].push_back(task);
+  });
+
+  std::vector<int> seen(10000);
+  for (const auto& buffer : buffers) {
+    for (size_t task : buffer) ++seen[task];
+  }
+  EXPECT_THAT(seen, Each(1));
+}